@@ -182,7 +182,10 @@ SOURCES += SingleApplication/singleapplication.cpp \
     graphicsutilities.cpp \
     helpdlg.cpp \
     igramarea.cpp \
+    igramfolderwatcher.cpp \
+    igramimage.cpp \
     igramintensity.cpp \
+    igrampipeline.cpp \
     imagehisto.cpp \
     intensityplot.cpp \
     jitteroutlinedlg.cpp \
@@ -247,11 +250,17 @@ SOURCES += SingleApplication/singleapplication.cpp \
     userdrawnprofiledlg.cpp \
     utilil.cpp \
     videosetupdlg.cpp \
+    vortex.cpp \
     vortexdebug.cpp \
     wavefront.cpp \
     wavefrontaveragefilterdlg.cpp \
+    wavefrontcatalog.cpp \
+    wavefrontcatalogdlg.cpp \
+    wavefrontfile.cpp \
     wavefrontfilterdlg.cpp \
     wavefrontloader.cpp \
+    wavefrontresidency.cpp \
+    wavefrontsaver.cpp \
     wftexaminer.cpp \
     wftstats.cpp \
     zapm.cpp \
@@ -303,7 +312,10 @@ HEADERS += bezier/bezier.h \
     graphicsutilities.h \
     helpdlg.h \
     IgramArea.h \
+    igramfolderwatcher.h \
+    igramimage.h \
     igramintensity.h \
+    igrampipeline.h \
     imagehisto.h \
     intensityplot.h \
     jitteroutlinedlg.h \
@@ -371,8 +383,13 @@ HEADERS += bezier/bezier.h \
     vortexdebug.h \
     wavefront.h \
     wavefrontaveragefilterdlg.h \
+    wavefrontcatalog.h \
+    wavefrontcatalogdlg.h \
+    wavefrontfile.h \
     wavefrontfilterdlg.h \
     wavefrontloader.h \
+    wavefrontresidency.h \
+    wavefrontsaver.h \
     wavefrontstats.h \
     wftexaminer.h \
     wftstats.h \
@@ -459,6 +476,7 @@ FORMS += arbitrarywavefronthelp.ui \
     videosetupdlg.ui \
     vortexdebug.ui \
     wavefrontaveragefilterdlg.ui \
+    wavefrontcatalogdlg.ui \
     wavefrontfilterdlg.ui \
     wavefrontnulldlg.ui \
     wftexaminer.ui \
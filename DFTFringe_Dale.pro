@@ -62,6 +62,15 @@ SOURCES += main.cpp \
     metricsdisplay.cpp \
     reviewwindow.cpp \
     wavefrontloader.cpp \
+    wavefrontfile.cpp \
+    wavefrontresidency.cpp \
+    wavefrontsaver.cpp \
+    wavefrontcatalog.cpp \
+    wavefrontcatalogdlg.cpp \
+    igrampipeline.cpp \
+    vortex.cpp \
+    igramfolderwatcher.cpp \
+    igramimage.cpp \
     rotationdlg.cpp \
     wftstats.cpp \
     surfacepropertiesdlg.cpp \
@@ -180,6 +189,14 @@ HEADERS  += mainwindow.h \
     vortex.h \
     wavefrontstats.h \
     wavefrontloader.h \
+    wavefrontfile.h \
+    wavefrontresidency.h \
+    wavefrontsaver.h \
+    wavefrontcatalog.h \
+    wavefrontcatalogdlg.h \
+    igrampipeline.h \
+    igramfolderwatcher.h \
+    igramimage.h \
     rotationdlg.h \
     wftstats.h \
     surfacepropertiesdlg.h \
@@ -338,6 +355,7 @@ FORMS    += mainwindow.ui \
     videosetupdlg.ui \
     showaliasdlg.ui \
     wavefrontaveragefilterdlg.ui \
+    wavefrontcatalogdlg.ui \
     rejectedwavefrontsdlg.ui \
     outlinestatsdlg.ui \
     filteroutlinesdlg.ui \
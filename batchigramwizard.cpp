@@ -17,6 +17,8 @@ QCheckBox *batchIgramWizard::filterCb = 0;
 QPushButton *batchIgramWizard::goPb = 0;
 QPushButton *batchIgramWizard::skipFile = 0;
 QPushButton *batchIgramWizard::addFiles = 0;
+QPushButton *batchIgramWizard::watchFolder = 0;
+QLabel *batchIgramWizard::watchStatus = 0;
 QCheckBox *batchIgramWizard::saveFile = 0;
 QCheckBox *batchIgramWizard::showProcessPlots = 0;
 QCheckBox *batchIgramWizard::deletePreviousWave;
@@ -148,6 +150,13 @@ batchIntro::batchIntro(QStringList files, QWidget *manager, QWidget *p):
     connect(batchIgramWizard::skipFile, SIGNAL(clicked(bool)), qobject_cast<MainWindow *>(manager), SLOT(skipBatchItem()));
     batchIgramWizard::skipFile->setEnabled(false);
     connect(batchIgramWizard::addFiles, SIGNAL(pressed()), this, SLOT(addFiles()));
+    batchIgramWizard::watchFolder = new QPushButton(tr("Watch Folder"));
+    batchIgramWizard::watchFolder->setCheckable(true);
+    batchIgramWizard::watchFolder->setToolTip(tr("Process each new interferogram written to a folder as it arrives\n"
+                                                 "using the last outline and center filter."));
+    connect(batchIgramWizard::watchFolder, SIGNAL(clicked(bool)), this, SLOT(on_watchFolder(bool)));
+    connect(this, SIGNAL(watchFolderChanged(QString)), qobject_cast<MainWindow *>(manager), SLOT(batchWatchFolder(QString)));
+    batchIgramWizard::watchStatus = new QLabel();
     batchIgramWizard::autoCb = new QCheckBox(tr("Auto"),this);
     batchIgramWizard::filterCb = new QCheckBox(tr("Filter"),this);
     batchIgramWizard::filterCb->setChecked( set.value("batchWizardFilterFlag", false).toBool());
@@ -203,6 +212,7 @@ batchIntro::batchIntro(QStringList files, QWidget *manager, QWidget *p):
     hlayout->addWidget(batchIgramWizard::deletePreviousWave);
     hlayout->addWidget(batchIgramWizard::addFiles);
     hlayout->addWidget(batchIgramWizard::skipFile);
+    hlayout->addWidget(batchIgramWizard::watchFolder);
     batchIgramWizard::memStatus = new QLabel();
     QVBoxLayout *layout = new QVBoxLayout();
     astigPlot = new astigScatterPlot;
@@ -217,6 +227,7 @@ batchIntro::batchIntro(QStringList files, QWidget *manager, QWidget *p):
     layout->addLayout(hlayout);
     layout->addWidget(outlineGB);
     layout->addWidget(filesList);
+    layout->addWidget(batchIgramWizard::watchStatus);
     hlayout3->addWidget(batchIgramWizard::goPb,0, Qt::AlignLeft);
     hlayout3->addWidget(batchIgramWizard::showProcessPlots);
     hlayout3->addWidget(batchIgramWizard::makeReviewAvi);
@@ -239,6 +250,22 @@ void batchIntro::on_deletePreviousWave(bool flag){
     set.setValue("deletePrevWave", flag);
 }
 
+void batchIntro::on_watchFolder(bool flag){
+    if (!flag){
+        emit watchFolderChanged(QString());
+        return;
+    }
+    QSettings set;
+    QString dir = QFileDialog::getExistingDirectory(this, tr("Folder the interferograms are written to"),
+                                                    set.value("watchFolder", set.value("lastPath",".")).toString());
+    if (dir.isEmpty()){
+        batchIgramWizard::watchFolder->setChecked(false);
+        return;
+    }
+    set.setValue("watchFolder", dir);
+    emit watchFolderChanged(dir);
+}
+
 void batchIntro::on_filter(bool flag){
     QSettings set;
     set.setValue("batchWizardFilterFlag", flag);
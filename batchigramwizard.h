@@ -30,6 +30,8 @@ public:
     static QPushButton *goPb;
     static QPushButton *skipFile;
     static QPushButton *addFiles;
+    static QPushButton *watchFolder;
+    static QLabel *watchStatus;
     static QCheckBox *saveFile;
     static QCheckBox *deletePreviousWave;
     static QCheckBox *showProcessPlots;
@@ -89,9 +91,11 @@ public slots:
     void on_filter(bool);
     void on_saveFiles(bool);
     void on_deletePreviousWave(bool);
+    void on_watchFolder(bool);
 
 signals:
     void processBatchList(QStringList);
+    void watchFolderChanged(QString);   // empty when watching stops
 private:
     wavefrontFilterDlg *filterDlg;
     void setupPlots();
@@ -19,6 +19,8 @@
 #include "ui_dftarea.h"
 #include "dfttools.h"
 #include "vortex.h"
+#include "igrampipeline.h"
+#include "igramimage.h"
 #include <queue>
 #include "punwrap.h"
 #include "zernikeprocess.h"
@@ -28,64 +30,19 @@
 #include "utils.h"
 #include "showaliasdlg.h"
 #include <QLabel>
+#include <QProgressDialog>
 #include <QShortcut>
+#include <QCryptographicHash>
+#include <QtConcurrent>
 #include <opencv2/core/core_c.h>
 using namespace cv;
 
 
 cv::Mat  makeMask(CircleOutline outside, CircleOutline center, cv::Mat data,
                   QVector<std::vector<cv::Point> > poly){
-    int width = data.cols;
-    int height = data.rows;
-    double radm = ceil(outside.m_radius) + 1;
-    double rady = radm;
     mirrorDlg &md = *mirrorDlg::get_Instance();
-    if (md.isEllipse())
-        rady = radm * md.m_verticalAxis/md.diameter;
-    double rado = center.m_radius;
-    double cx = outside.m_center.x();
-    double cy = outside.m_center.y();
-    cv::Mat mask = cv::Mat::zeros(height,width,CV_8UC1);
-
-    for (int y = 0; y < height; ++y){
-        for (int x = 0; x < width; ++x){
-            double dx = (double)(x - cx)/(radm);
-            double dy = (double)(y - cy)/(rady);
-            if (sqrt(dx * dx + dy * dy) <= 1.)
-                mask.at<uchar>(y,x) = 255;
-        }
-    }
-    cx = center.m_center.x();
-    cy = center.m_center.y();
-    if (rado > 0) {
-        for (int y = 0; y < height; ++y){
-            for (int x = 0; x < width; ++x){
-                double dx = (double)(x - (cx))/(rado);
-                double dy = (double)(y - (cy))/(rado);
-                if (sqrt(dx * dx + dy * dy) < 1.)
-                    mask.at<uchar>(y,x) = 0;
-            }
-        }
-    }
-    if (poly.size()>0){
-        for (int n = 0; n < poly.size(); ++n){
-            cv::Point points[1][poly[n].size()];
-            for (std::size_t i = 0; i < poly[n].size(); ++i){
-
-                points[0][i] = cv::Point(poly[n][i].x, poly[n][i].y);
-
-            }
-            for (std::size_t j = 0; j < poly[n].size()-1; ++j){
-                cv::line(mask, points[0][j], points[0][j+1], cv::Scalar(0));
-
-            }
-            const Point* ppt[1] = { points[0]};
-            int npt[] = { static_cast<int>(poly[n].size()) };
-
-            fillPoly( mask, ppt, npt, 1, Scalar(0), 8 );
-        }
-    }
-
+    cv::Mat mask = makeIgramMask(outside, center, data.size(), poly, md.isEllipse(),
+                                 md.m_verticalAxis/md.diameter);
     if (Settings2::showMask())
         showData("DFT mask",mask);
     return mask;
@@ -102,7 +59,7 @@ DFTArea * DFTArea::get_Instance(QWidget *parent, IgramArea *ip, DFTTools *tools,
 DFTArea::DFTArea(QWidget *mparent, IgramArea *ip, DFTTools * tools, vortexDebug *vdbug) :
     QWidget(mparent),m_size(640), tools(tools),
     dftSizeStr("640 X 640"), m_center_filter(10.),ui(new Ui::DFTArea),igramArea(ip),m_smooth(9.),
-    m_vortexDebugTool(vdbug),zoom(1.)
+    m_vortexDebugTool(vdbug),zoom(1.),m_lastPreviewId(0)
 
 {
     m_outlineComplete = false;
@@ -120,12 +77,21 @@ DFTArea::DFTArea(QWidget *mparent, IgramArea *ip, DFTTools * tools, vortexDebug
     connect(m_Psidlg, SIGNAL(computePhase()),this, SLOT(computePhases()));
     ui->setupUi(this);
     m_gamma = 2.5;
+    m_spectrumMin = m_spectrumMax = 0;
 
     connect(tools,SIGNAL(dftChannel(const QString&)), this, SLOT(setChannel(const QString&)));
     connect(tools,SIGNAL(dftSizeVal(int)), this, SLOT(dftSizeVal(int)));
     connect(tools,SIGNAL(dftCenterFilter(double)), this, SLOT(dftCenterFilter(double)));
-    connect(tools,SIGNAL(makeSurface()), this,SLOT(makeSurface()));
+    connect(tools,SIGNAL(makeSurface()), this,SLOT(makeSurfaceInBackground()), Qt::UniqueConnection);
     connect(tools,SIGNAL(doDFT()), this,SLOT(doDFT()));
+
+    m_surfaceWatcher = new QFutureWatcher<void>(this);
+    connect(m_surfaceWatcher, SIGNAL(finished()), this, SLOT(surfaceJobDone()));
+    m_surfaceProgress = new QProgressDialog("Making surface", "Cancel", 0, 3, this);
+    m_surfaceProgress->setWindowModality(Qt::NonModal);
+    m_surfaceProgress->setAutoClose(false);
+    m_surfaceProgress->reset();     // don't pop up until a surface is being made
+    connect(m_surfaceProgress, SIGNAL(canceled()), this, SLOT(cancelSurfaceJob()));
     connect(tools,SIGNAL(showResized()),this, SLOT(showResizedDlg()));
 
     QShortcut *shortcut = new QShortcut(QKeySequence(Qt::Key_Plus), this);
@@ -222,6 +188,8 @@ void DFTArea::setChannel(const QString& val){
 void DFTArea::dftCenterFilter(double v){
 
     m_center_filter = v;
+    if (m_surfaceJob && m_surfaceJob->vp.low != v)
+        m_surfaceJob->canceled.storeRelease(1);     // full resolution surface of the old filter is not wanted
     QSettings set;
     set.setValue("DFT Center Filter", v);
     emit updateFilterSize(v);
@@ -244,124 +212,32 @@ void DFTArea::dftSizeChanged(const QString& val){
     }
 }
 
-cv::Mat DFTArea::grayComplexMatfromImage(QImage &img){
-    // create an roi that is a square around the outline.
-    double centerX = igramArea->m_outside.m_center.x();
-    double centerY = igramArea->m_outside.m_center.y();
-    mirrorDlg &md = *mirrorDlg::get_Instance();
-
-    double pixelsPermm =(igramArea->m_outside.m_radius/(md.diameter/2.));
-    double reduction = md.aperatureReduction * pixelsPermm;
-    if (md.m_aperatureReductionEnabled == false)
-        reduction = 0;
-
-    double rad = igramArea->m_outside.m_radius - reduction;
-
-
-    double rady = rad;
-
-    if (md.isEllipse()){
-        rady = rady * md.m_verticalAxis/ md.diameter;
-    }
-
-    double left = centerX - rad;
-    double top = centerY - rad;
-    std::vector<Mat > bgr_planes;
-    top = std::max(top,0.);
-    left = std::max(left,0.);
-    int width = 2. * (rad);
-    int height = width;
-    width = min(width, img.width());
-    height = min(height, img.height());
-
-    // new center because of crop
-    double xCenterShift = centerX - left;
-    double yCenterShift = centerY - top;
-
-    cv::Mat iMat(img.height(), img.width(), CV_8UC3, img.bits(), img.bytesPerLine());
-    cv::Mat tmp = iMat.clone();
-    cv::Mat roi = iMat(cv::Rect((int)left,(int)top,(int)width,(int)height)).clone();
-
-    double centerDx = centerX - igramArea->m_center.m_center.x();
-    double centerDy = centerY - igramArea->m_center.m_center.y();
-
-    roi.convertTo(roi,CV_32FC3);
-    QSettings set;
-    int dftSize = set.value("DFTSize", 640).toInt();
-    double scaleFactor = (double)dftSize/roi.cols;
-
-    m_outside = CircleOutline(QPointF(xCenterShift,yCenterShift), rad);
-    m_center = CircleOutline(QPointF(xCenterShift - centerDx, yCenterShift - centerDy),
-                             igramArea->m_center.m_radius);
-
-    //scaleFactor = 1;
-    if (scaleFactor < 1.){
-
-        cv::resize(roi,roi, cv::Size(0,0), scaleFactor, scaleFactor,INTER_AREA);
-        double roicx = (roi.cols-1)/2.;
-        double roicy = (roi.rows-1)/2.;
-        m_outside = CircleOutline(QPointF(roicx,roicy),roicx);
-        m_center = CircleOutline(QPointF((roicx - centerDx * scaleFactor), (roicy - centerDy * scaleFactor)),
-                                 m_center.m_radius * scaleFactor);
-    }
-    else {
-        scaleFactor = 1.;
-    }
-    m_poly.clear();
-    for (int n = 0; n < igramArea->m_polygons.size(); ++n){
-        m_poly.append(std::vector< cv::Point>());
-        for (unsigned int i = 0; i < igramArea->m_polygons[n].size(); ++i){
-            int x = round((igramArea->m_polygons[n][i].x - left) * scaleFactor);
-            int y = round((igramArea->m_polygons[n][i].y - top) * scaleFactor);
-
-            // make sure x and y values of regions are inside our matrix
-            if (x < 0)
-                x=0;
-            if (x >= roi.cols)
-                x=roi.cols-1;
-            if (y < 0)
-                y=0;
-            if (y >= roi.rows)
-                y = roi.rows-1;
-
-            m_poly.back().push_back(cv::Point(x,y));
-        }
-    }
-    // split image into three color planes
-    split( roi, bgr_planes );
-
-    cv::Scalar mean;
-    mean =  cv::mean(bgr_planes[0]);
-
-    n = 0;
-
-
-    cv::Mat padded = bgr_planes[0].clone();
-    padded = padded - mean[0];
-
-
-    // disabled adding optomizing DFT boarder.
-    Mat planes[] = {Mat_<float>(padded), Mat::zeros(padded.size(), CV_32F)};
-
-    m_mask = makeMask(m_outside,m_center,*planes, m_poly);
+cv::Mat DFTArea::grayMatfromImage(QImage &img){
+    // igramGray is the single color plane picked by IgramArea
+    cv::Mat gray = igramImageToMat(img);
+    if (gray.channels() > 1){
+        cv::Mat plane;
+        cv::extractChannel(gray, plane, 0);
+        gray = plane;
+    }
+
+    igramCrop crop;
+    prepareIgram(gray, igramArea->m_outside, igramArea->m_center, igramArea->m_polygons,
+                 igramPipelineParams::fromSettings(), crop);
+    m_outside = crop.outside;
+    m_center = crop.center;
+    m_poly = crop.poly;
+    m_mask = crop.mask;
     if (Settings2::showMask())
         showData("Mask", m_mask);
-    cv::Mat tmpMask;
-
-    planes[0].copyTo(tmpMask,m_mask);    // Convert image to binary
-    planes[0] = tmpMask.clone();
-    mean =  cv::mean(planes[0],m_mask);
-
-    planes[0] -= mean;
+    n = 0;
 
-    Mat  complexI;
-    merge(planes, 2, complexI);         // Add to the expanded another plane with zeros
-    if (scaleFactor == 1.){
-        tools->imageSize(QString("DFT Size will be %1").arg(width));
+    if (crop.image.cols == crop.width){
+        tools->imageSize(QString("DFT Size will be %1").arg(crop.width));
     }
     else
-        tools->imageSize(QString("Image is resized from %1 to %2 pixels").arg(width).arg(complexI.cols));
-    return complexI;
+        tools->imageSize(QString("Image is resized from %1 to %2 pixels").arg(crop.width).arg(crop.image.cols));
+    return crop.image;
 }
 
 //swap quadrants
@@ -445,29 +321,36 @@ void DFTArea::doDFT(){
     QApplication::setOverrideCursor(Qt::WaitCursor);
     QImage img = igramArea->igramGray;
 
-    cv::Mat complexI = grayComplexMatfromImage(img);
-
-    cv::Mat planes[2];
-
-    split(complexI,planes);
+    cv::Mat gray = grayMatfromImage(img);
 
     cv::Scalar mean,std;
-    cv::meanStdDev(planes[0],mean,std, m_mask);
+    cv::meanStdDev(gray,mean,std, m_mask);
     //qDebug() << "Mean " << mean[0];
-    planes[0] -= mean[0];
-    //cv::imshow("input", planes[0].clone());
+    gray -= mean[0];
 
-    //cv::waitKey(1);
-    cv::merge(planes,2,complexI);
-    dft(complexI, complexI);
-    cv::Mat realImage;
-    dft(complexI,realImage,DFT_INVERSE);
-    split(realImage,planes);
+    // real input transform unpacked to the full spectrum for the display
+    cv::Mat complexI;
+    dft(gray, complexI, DFT_COMPLEX_OUTPUT);
+    gray.release();
 
     shiftDFT(complexI);
-    m_dft.release();
-    m_dft = complexI/complexI.size().area();
-    magIImage = showMag(complexI,false,"", true, m_gamma);
+
+    // same scale as showMag up to its gamma
+    cv::Mat planes[2];
+    split(complexI, planes);
+    complexI.release();
+    cv::Mat mag;
+    magnitude(planes[0], planes[1], mag);
+    double mmin, mmax;
+    minMaxIdx(mag, &mmin, &mmax);
+    mag -= mmin;
+    log(mag + 0.1, mag);
+    mag = cv::abs(mag);     // pow uses the absolute value
+    minMaxIdx(mag, &m_spectrumMin, &m_spectrumMax);
+    double range = std::max(m_spectrumMax - m_spectrumMin, 1e-12);
+    mag.convertTo(m_spectrumLevels, CV_16U, 65535./range, -m_spectrumMin * 65535./range);
+    m_spectrumKey = spectrumKey();
+    magIImage = toneMapSpectrum(m_gamma);
 
 
     magIImage = magIImage.scaled(magIImage.width() , magIImage.height() );
@@ -495,7 +378,53 @@ void DFTArea::doDFT(){
 void DFTArea::gamma(int i){
     double v = 1. + 5. * (double)i/99.;
     m_gamma = v;
-    doDFT();
+    if (m_spectrumLevels.empty() || m_spectrumKey != spectrumKey()){
+        doDFT();
+        return;
+    }
+    magIImage = toneMapSpectrum(m_gamma);
+    update();
+}
+
+// what the spectrum depends on besides the gamma
+QString DFTArea::spectrumKey(){
+    QSettings set;
+    QCryptographicHash polygons(QCryptographicHash::Md5);
+    for (int n = 0; n < igramArea->m_polygons.size(); ++n){
+        const std::vector<cv::Point> &poly = igramArea->m_polygons[n];
+        int count = poly.size();
+        polygons.addData(reinterpret_cast<const char *>(&count), sizeof(count));
+        if (count)
+            polygons.addData(reinterpret_cast<const char *>(&poly[0]), count * sizeof(cv::Point));
+    }
+    return QString("%1 %2 %3 %4 %5 %6 %7 %8 %9").arg(igramArea->igramGray.cacheKey())
+            .arg(igramArea->m_outside.m_center.x()).arg(igramArea->m_outside.m_center.y())
+            .arg(igramArea->m_outside.m_radius).arg(igramArea->m_center.m_center.x())
+            .arg(igramArea->m_center.m_center.y()).arg(igramArea->m_center.m_radius)
+            .arg(QString(polygons.result().toHex())).arg(set.value("DFTSize", 640).toInt());
+}
+
+// the gamma curve of showMag as a lookup table on the cached levels
+QImage DFTArea::toneMapSpectrum(double gamma){
+    std::vector<uchar> lut(65536);
+    double step = (m_spectrumMax - m_spectrumMin)/65535.;
+    double g0 = pow(m_spectrumMin, gamma);
+    double g1 = pow(m_spectrumMax, gamma);
+    double scale = g1 > g0 ? 255./(g1 - g0) : 0.;
+    for (int q = 0; q < 65536; ++q)
+        lut[q] = cv::saturate_cast<uchar>((pow(m_spectrumMin + q * step, gamma) - g0) * scale);
+
+    QImage img(m_spectrumLevels.cols, m_spectrumLevels.rows, QImage::Format_RGB888);
+    for (int y = 0; y < m_spectrumLevels.rows; ++y){
+        const ushort *levels = m_spectrumLevels.ptr<ushort>(y);
+        uchar *rgb = img.scanLine(y);
+        for (int x = 0; x < m_spectrumLevels.cols; ++x){
+            uchar v = lut[levels[x]];
+            rgb[0] = rgb[1] = rgb[2] = v;
+            rgb += 3;
+        }
+    }
+    return img;
 }
 
 void DFTArea::paintEvent(QPaintEvent *)
@@ -536,445 +465,252 @@ void DFTArea::paintEvent(QPaintEvent *)
 
 
 
-#define WRAP(x) (((x) > 0.5) ? ((x)-1.0) : (((x) <= -0.5) ? ((x)+1.0) : (x)))
-#define WRAPPI(x) (((x) > M_PI) ? ((x)-2*M_PI) : (((x) <= -M_PI) ? ((x)+2*M_PI) : (x)))
-
-#define BORDER      0x1
-#define UNWRAPPED   0x2
-double *g_qmap;
-class comp_qual {
-public:
-  int operator() (const int &p1, const int &p2) {
-    return (g_qmap[p1] < g_qmap[p2]);
-  }
-};
-#define unwrap_and_insert(ndx, val) \
-  { \
-    unwrapped[ndx] = val;  \
-    flags[ndx] |= UNWRAPPED; \
-    path[ndx] = order++; \
-    todo.push (ndx); \
-  }
-
-// Quality-guided path following phase unwrapper.
-void qg_path_follower_vortex (Size size, double *phase, double *qmap,
-               double *unwrapped, double *path)
-{
-  std::priority_queue<int, std::vector<int>, comp_qual> todo;
-  int total = size.area();
-  int order = 0;
-  g_qmap = qmap;
-
-  // Initialize the flags array to mark the border.
-  char *flags = new char[total];
-  for (int k=0; k < total; ++k)
-    flags[k] = phase[k] == 0.0;
-
-  // Repeat while still elements to unwrap (handles disjoint regions).
-  while (1) {
-
-    // Find the point of highest quality.
-    double m = -HUGE_VAL;
-    int mndx;
-    for (int k=0; k < total; ++k)
-      if (qmap[k] > m && ! flags[k])
-    m = qmap[mndx = k];
-    if (m == -HUGE_VAL) break;
-
-    // Unwrap the first point.
-    unwrap_and_insert (mndx, phase[mndx]);
-
-    // Unwrap the rest of the points in order of quality.
-    while (!todo.empty()) {
-      int ndx = todo.top();
-      todo.pop();
-      int x = ndx%size.width;
-      int y = ndx/size.width;
-      double val = unwrapped[ndx];
-      if (x > 0 && ! flags[ndx-1])
-    unwrap_and_insert (ndx-1, val+WRAP(phase[ndx-1]-phase[ndx]));
-      if (x < size.width-1 && ! flags[ndx+1])
-    unwrap_and_insert (ndx+1, val+WRAP(phase[ndx+1]-phase[ndx]));
-      if (y > 0 && ! flags[ndx-size.width])
-    unwrap_and_insert (ndx-size.width, val+WRAP(phase[ndx-size.width]-phase[ndx]));
-      if (y < size.height-1 && ! flags[ndx+size.width])
-    unwrap_and_insert (ndx+size.width, val+WRAP(phase[ndx+size.width]-phase[ndx]));
-    }
-  }
-  delete[] flags;
-}
-
-
-
 cv::Mat DFTArea::vortex(QImage &img, double low)
   {
 
     try
     {
     showmem("start Vortex");
-    cv::Mat image = grayComplexMatfromImage(img);
-
-    // convert from 32 to 64 bit double values
-    cv::Mat imageMat;
-    image.convertTo(imageMat, numType);
-    image.release();
-
-    int xsize = imageMat.cols;
-    int ysize = imageMat.rows;
-
-    int size = xsize*ysize;
-    double smooth = .01 * m_vortexDebugTool->m_smooth * xsize/2.;
-    double *dir = new double[size];
-    double *path = new double[size];
-    double *qmap = new double[size];
-    double *orient = new double[size];
-
-    //double *fdom[2]; fdom[0] = new double[size]; fdom[1] = new double[size];
-    double *d1[2]; d1[0] = new double[size]; d1[1] = new double[size];
-    double *d2[2]; d2[0] = new double [size]; d2[1] = new double [size];
-
-    double *spiralRe = new double [size];
-    double *spiralIm = new double[size];
-
-
-    if (m_vortexDebugTool->m_showInput){
-        double *imReTmp = new double[size];
-        {
-            cv::Mat tmp = cv::Mat(ysize,xsize,numType, imReTmp);
-            cv::Mat xx;
-            tmp.convertTo(xx,CV_32F);
-            cv::imshow("input", xx);
-            cv::waitKey(1);
-        } // delete imReTmp after tmp is destructed by end of scope
-        delete[] imReTmp;
-    }
-
-    cv::Mat fdomMat;
-    cv::Mat fdomPlanes[2];
-
-
-    dft(imageMat,fdomMat);
-    split(fdomMat, fdomPlanes);
-
-
-    // Create rho and theta arrays for later use.
-    int *ix = new int[xsize];
-    int *iy = new int[ysize];
-    for (int i=0; i<=xsize/2; ++i) ix[i] = -i;
-    for (int i=1; i<=xsize/2; ++i) ix[xsize-i] = i;
-    for (int i=0; i<=ysize/2; ++i) iy[i] = -i;
-    for (int i=1; i<=ysize/2; ++i) iy[ysize-i] = i;
-
-
-    double *rho = new double[size];
-    double *theta = new double[size];
-
-    for (int j=0; j<ysize; ++j) {
-      int base = j*xsize;
-      for (int i=0; i<xsize; ++i) {
-        rho[base+i] = sqrt (ix[i]*ix[i] + iy[j]*iy[j]);
-        theta[base+i] = atan2 (iy[j], ix[i]);
-      }
-    }
-    delete[] ix;
-    delete[] iy;
-    // High-pass filter the Fourier domain to remove the background.
-    double *planes[2] = {fdomPlanes[0].ptr<double>(0), fdomPlanes[1].ptr<double>(0)};
-    if (low > 0)
-    {
-        for (int i=0; i<size; ++i) {
-          double a = 1.0 - exp (-(rho[i]*rho[i])/(low*low));
-
-            planes[0][i] *= a;
-            planes[1][i] *= a;
-        }
-    }
-    merge(fdomPlanes,2, fdomMat);
-    if (m_vortexDebugTool->m_showFdom){
-        showMag(fdomMat.clone(),true,"fdom");
-    }
-
-    // Take the inverse Fourier transform to get the cleaned igram.
-
-    //p = fftw_plan_dft_2d (ysize, xsize, fdom, im, FFTW_BACKWARD, FFTW_ESTIMATE);
-    //fftw_execute (p);
-    dft(fdomMat, imageMat, DFT_INVERSE);
-    cv::Mat imPlanes[2];
-    split(imageMat,imPlanes);
-
-
-
-    imPlanes[0]/= size;
-    cv::Mat tmp;
-    imPlanes[0].copyTo(tmp, m_mask);
-    imPlanes[0] = tmp.clone();
-    tmp.release();
-    // Normalize the image by removing the exterior and centering values.
-    cv::Scalar mean,std;
-    cv::meanStdDev(imPlanes[0],mean,std, m_mask);
-    double sum = 0;
-    double *q = imPlanes[0].ptr<double>(0);
-
-    merge(imPlanes,2, imageMat);
-
-    dft(imageMat,fdomMat);
-    imageMat.release();
-
-    double dc = fdomMat.at<double>(0,0,0);
-    dc/=size;
-    int count = 0;
-    bool *bp = m_mask.ptr<bool>(0);
-    for (int i = 0; i < size; ++i){
-        if (bp[i]){
-            sum += q[i];
-            if (q[i] != 0.0)
-            ++count;
-        }
-    }
-    double m2 = sum/count;
-    imPlanes[0] -= m2;
-
-    imPlanes[1] *= 0.;
-
-    double *imRe = (double *)(imPlanes[0].data);
-    if (0) { //(0 == strcmp (what, "im2")) {
-        showData("im border added", imPlanes[0].clone());
+    cv::Mat image = grayMatfromImage(img);
+    vortexParams vp = vortexSettings(low);
+    VortexEngine *engine = VortexEngine::forThread();
+    cv::Mat phase = engine->phase(image, m_mask, vp);
+    qDebug() << "vortex size" << engine->paddedSize().width << engine->paddedSize().height
+             << "workspace" << engine->workspaceBytes()/(1024 * 1024) << "MB";
+    qDebug() << "vortex" << engine->timings().toString();
+    return phase;
     }
+    catch (std::bad_alloc &e){
+        showmem();
+        qDebug() << QString("Error %1").arg(e.what());
+       //cv::Mat phase = cv::Mat::zeros(Size(100,100), numType);
 
-    // Calculate the intermediate values d1 and d2.
-
-    for (int i=0; i<size; ++i) {
-      spiralRe[i] = cos(theta[i]);
-      spiralIm[i] = sin(theta[i]);
+       return cv::Mat();
     }
-    delete[] theta;
-
-    split(fdomMat,fdomPlanes);
-    double *fdomRe = (double*)(fdomPlanes[0].data);
-    double *fdomIm = (double *)(fdomPlanes[1].data);
+    catch ( std::exception &e){
 
-    for (int i=0; i<size; ++i) {
-      double re = fdomRe[i]*spiralRe[i] - fdomIm[i]*spiralIm[i];
-      double im = fdomRe[i]*spiralIm[i] + fdomIm[i]*spiralRe[i];
-      fdomRe[i] = re;
-      fdomIm[i] = im;
+        qDebug() << QString(" some Error %1").arg(e.what());
+       cv::Mat phase = cv::Mat::zeros(Size(0,0), numType);
+       return phase;
     }
-    merge(fdomPlanes,2,fdomMat);
-    cv::Mat d1Mat;
-    dft(fdomMat,d1Mat, DFT_INVERSE);
-    //p = fftw_plan_dft_2d (ysize, xsize, fdomMat, d1Mat, FFTW_BACKWARD, FFTW_ESTIMATE);
-    //fftw_execute (p);
-    d1Mat/= size;
-
-    if (0){ //(0 == strcmp (what, "d1")) {
-        showMag(d1Mat.clone(), true, "D1");
+    catch (...){
+        qDebug() << QString(" Unknown error ");
+       cv::Mat phase = cv::Mat::zeros(Size(100,100), numType);
+       return phase;
     }
 
+}
 
-    for (int i=0; i<size; ++i) {
-      double re = fdomRe[i]*spiralRe[i] - fdomIm[i]*spiralIm[i];
-      double im = fdomRe[i]*spiralIm[i] + fdomIm[i]*spiralRe[i];
-      fdomRe[i] = re;
-      fdomIm[i] = im;
-    }
-    cv::Mat d2Mat;
-    merge(fdomPlanes,2, fdomMat);
-    dft(fdomMat,d2Mat,DFT_INVERSE);
-    //p = fftw_plan_dft_2d (ysize, xsize, fdom, d2, FFTW_BACKWARD, FFTW_ESTIMATE);
-    //fftw_execute (p);
-    d2Mat/= size;
-
-    if (0){//(0 == strcmp (what, "d2")) {
-        showMag(d2Mat.clone(),true, "D2");
-    }
+vortexParams DFTArea::vortexSettings(double low){
+    vortexParams vp;
+    vp.low = low;
+    vp.smooth = m_vortexDebugTool->m_smooth;
+    vp.showInput = m_vortexDebugTool->m_showInput;
+    vp.showFdom = m_vortexDebugTool->m_showFdom;
+    vp.showOrientation = m_vortexDebugTool->m_showOrientation;
+    vp.showFdom3 = m_vortexDebugTool->m_showFdom3;
+    vp.showWrapped = m_vortexDebugTool->m_showWrapped;
+    vp.singlePrecision = Settings2::m_dft->singlePrecision();
+    vp.unwrapper = (unwrapMethod)Settings2::m_dft->unwrapMethod();
+    return vp;
+}
 
+// the debug displays use opencv windows which only work on the gui thread
+bool DFTArea::showsVortexDebug(){
+    return m_vortexDebugTool->m_showInput || m_vortexDebugTool->m_showFdom ||
+            m_vortexDebugTool->m_showOrientation || m_vortexDebugTool->m_showFdom3 ||
+            m_vortexDebugTool->m_showWrapped || m_vortexDebugTool->m_showUnwrapped ||
+            Settings2::showMask();
+}
 
-    cv::Mat rMat;
-    cv::Mat rPlanes[2] = {cv::Mat::zeros(Size(xsize,ysize),numType), cv::Mat::zeros(Size(xsize,ysize),numType)};
-    cv::Mat d1Planes[2];
-    cv::Mat d2Planes[2];
+// An interferogram with its outlines and settings copied when make surface is pressed.  The worker only
+// uses these copies so the igram tab can load and outline the next interferogram meanwhile.
+struct surfaceJob {
+    QImage igram;
+    CircleOutline outside;
+    CircleOutline center;
+    QVector<std::vector<cv::Point> > poly;
+    igramPipelineParams params;
+    vortexParams vp;
+    QString name;
+    QString fileName;
+    QAtomicInt canceled;
+    int previewId;          // a newer job of the same igram keeps the id and replaces the preview
+    igramCrop previewCrop;
+    cv::Mat preview;
+    igramCrop crop;         // outlines are flipped to match the result
+    cv::Mat result;
+    QString error;
+    surfaceJob(): previewId(0) {}
+};
 
-    split(d1Mat,d1Planes);
-    d1Mat.release();
-    split(d2Mat,d2Planes);
-    d2Mat.release();
+// dft size of the quick surface made before the full size one
+static const int previewSize = 256;
 
-    double *d1Re = (double *)(d1Planes[0].data);
-    double *d1Im = (double *)(d1Planes[1].data);
-    double *d2Re = (double *)(d2Planes[0].data);
-    double *d2Im = (double *)(d2Planes[1].data);
-    double *rRe = (double *)(rPlanes[0].data);
-    double *rIm = (double *)(rPlanes[1].data);
+enum surfaceJobStages {
+    SURFACE_PREPARE,
+    SURFACE_VORTEX,
+    SURFACE_UNWRAP,
+    SURFACE_FIT
+};
 
-    // Calculate the orientation and the quality map for unwrapping.
-    for (int i=0; i<size; ++i) {
-      rRe[i] = d1Re[i]*d1Re[i] - d1Im[i]*d1Im[i] - imRe[i]*d2Re[i];
-      rIm[i] = d1Re[i]*d1Im[i] + d1Im[i]*d1Re[i] - imRe[i]*d2Im[i];
+// Runs on a pool thread.  Reports the stage to receiver's surfaceJobStage slot.
+static void makeJobSurface(QSharedPointer<surfaceJob> job, QObject *receiver){
+    try {
+        cv::Mat gray = igramImageToMat(job->igram);
+        if (gray.channels() > 1){
+            cv::Mat plane;
+            cv::extractChannel(gray, plane, 0);
+            gray = plane;
+        }
+        if (job->params.dftSize > previewSize){
+            // same path at low resolution.  The center filter is in dft bins so it scales with the size.
+            igramPipelineParams p = job->params;
+            p.dftSize = previewSize;
+            prepareIgram(gray, job->outside, job->center, job->poly, p, job->previewCrop);
+            vortexParams vp = job->vp;
+            vp.low *= (double)job->previewCrop.image.cols / std::min(job->params.dftSize, job->previewCrop.width);
+            cv::Mat phase = vortexPhase(job->previewCrop.image, job->previewCrop.mask, vp);
+            job->previewCrop.image.release();
+            job->preview = unwrapIgramPhase(phase, job->previewCrop, p);
+            QMetaObject::invokeMethod(receiver, "surfaceJobPreview", Qt::QueuedConnection);
+            if (job->canceled.loadAcquire())
+                return;
+        }
+        prepareIgram(gray, job->outside, job->center, job->poly, job->params, job->crop);
+        gray.release();
+        if (job->canceled.loadAcquire())
+            return;
+        QMetaObject::invokeMethod(receiver, "surfaceJobStage", Qt::QueuedConnection, Q_ARG(int, SURFACE_VORTEX));
+        cv::Mat phase = vortexPhase(job->crop.image, job->crop.mask, job->vp);
+        job->crop.image.release();
+        if (job->canceled.loadAcquire())
+            return;
+        QMetaObject::invokeMethod(receiver, "surfaceJobStage", Qt::QueuedConnection, Q_ARG(int, SURFACE_UNWRAP));
+        job->result = unwrapIgramPhase(phase, job->crop, job->params);
     }
-
-    //smooth = 0;
-    if (smooth > 0) {
-
-        merge(rPlanes,2, rMat);
-
-        cv::Mat temp;
-        cv::Mat tempPlanes[2];
-      // Low-pass filter r to smooth it.
-      dft(rMat,temp);
-
-      //p = fftw_plan_dft_2d (ysize, xsize, r, temp, FFTW_FORWARD, FFTW_ESTIMATE);
-      //fftw_execute (p);
-      split(temp,tempPlanes);
-
-      double *tempRe = (double *)(tempPlanes[0].data);
-      double *tempIm = (double *)(tempPlanes[1].data);
-
-      for (int i=0; i<size; ++i) {
-        double a = exp (-(rho[i]*rho[i])/(smooth * smooth));
-        tempRe[i] *= a;
-        tempIm[i] *= a;
-      }
-      delete[] rho;
-
-      merge(tempPlanes,2,temp);
-
-      tempPlanes[0].release();
-      tempPlanes[1].release();
-
-      dft(temp,rMat,DFT_INVERSE);
-      temp.release();
-
-      //p = fftw_plan_dft_2d (ysize, xsize, temp, r, FFTW_BACKWARD, FFTW_ESTIMATE);
-      //fftw_execute (p);
-      rMat/= size;
-      split(rMat,rPlanes);
-      rMat.release();
+    catch (std::bad_alloc &){
+        job->error = "Possible out of memory problem.  If possible try deleting some wave front files.";
     }
-
-    for (int i=0; i<size; ++i)
-      orient[i] = atan2 (rIm[i], rRe[i]);
-
-    if (m_vortexDebugTool->m_showOrientation){
-        cv::Mat orm(ysize,xsize,numType,orient);
-        showData("orient", orm.clone());
+    catch (std::exception &e){
+        job->error = QString("Error making the surface %1").arg(e.what());
     }
+}
 
+// the pool thread does not keep the unwrap buffers once the job is done
+static void runSurfaceJob(QSharedPointer<surfaceJob> job, QObject *receiver){
+    makeJobSurface(job, receiver);
+    phaseUnwrapper::forThread()->clear();
+}
 
-    for (int i=0; i<size; ++i) {
-      qmap[i] = sqrt (rRe[i]*rRe[i] + rIm[i]*rIm[i]);
-      orient[i] /= (2.*M_PI);  // put in range -.5..5 for unwrap
+// Make surface from the dft tools.  The vortex transform and unwrap run on a worker thread and the
+// zernike fit on the gui thread when they are done.  A low resolution preview is shown first and replaced
+// by the full size surface.  Changing the center filter or pressing make surface again for the same igram
+// cancels the running job.  Batch processing and jitter use makeSurface which
+// waits for the result.
+void DFTArea::makeSurfaceInBackground(){
+    if (!tools->wasPressed)
+        return;
+    if (showsVortexDebug()){
+        makeSurface();
+        return;
     }
-
-    // Unwrap the orientation to get the direction.
-    qg_path_follower_vortex (Size(xsize,ysize), orient, qmap, dir, path);
-    for (int i=0; i<size; ++i)
-     dir[i] = WRAPPI(dir[i]*M_PI);
-
-    // Calculate the quadrature.
-    imPlanes[1] = cv::Mat::zeros(Size(xsize,ysize), numType);
-    double *imIm = (double *)(imPlanes[1].data);
-    for (int i=0; i<size; ++i)
-      imIm[i] = d1Re[i]*cos(-dir[i]) - d1Im[i]*sin(-dir[i]);
-
-      // Display the isolated side lobe.
-    if (m_vortexDebugTool->m_showFdom3){
-        cv::Mat sideLobe;
-        merge(imPlanes,2,sideLobe);
-        shiftDFT(sideLobe);
-        dft(sideLobe,fdomMat);
-        shiftDFT(fdomMat);\
-        showMag(fdomMat, true, "fdom3");
-        sideLobe.release();
+    MainWindow::me->m_outlinePlots->hide();
+    if (igramArea->igramGray.isNull()){
+        QMessageBox::warning(0,"warning","First load an interferogram and circle the mirror.");
+        return;
     }
-
-    cv::Mat phase(Size(xsize,ysize), numType);
-    double *p = (double *)(phase.data);
-    for (int i=0; i<size; ++i) {
-       p[i] = atan2 (imIm[i], imRe[i]);
-
+    tools->wasPressed = false;
+    if (Settings2::getInstance()->m_igram->m_autoSaveOutline){
+        igramArea->writeOutlines(igramArea->makeOutlineName());  // save outlines including center filter
     }
-
-    imPlanes[0].release();
-    imPlanes[1].release();
-    // mask to only the mirror portion.
-    phase.copyTo(tmp, m_mask);
-    phase = tmp.clone();
-    if (m_vortexDebugTool->m_showWrapped){
-        cv::Mat tt = phase.clone();
-        cv::normalize(tt,tt,0.f,1.f,CV_MINMAX);
-        cv::imshow(" wrapped ", tt);
-        cv::waitKey(1);
+    QSharedPointer<surfaceJob> job(new surfaceJob);
+    job->igram = igramArea->igramGray;      // shared until the igram tab changes it
+    job->outside = igramArea->m_outside;
+    job->center = igramArea->m_center;
+    job->poly = igramArea->m_polygons;
+    job->params = igramPipelineParams::fromSettings();
+    job->vp = vortexSettings(m_center_filter);
+    job->name = QFileInfo(igramArea->m_filename).baseName();
+    job->fileName = igramArea->m_filename;
+
+    job->previewId = ++m_lastPreviewId;
+
+    if (m_surfaceJob){
+        if (m_surfaceJob->fileName == job->fileName){
+            // new filter or outline for the same igram.  The running one is stale.
+            job->previewId = m_surfaceJob->previewId;
+            m_surfaceJob->canceled.storeRelease(1);
+        }
+        m_nextSurfaceJob = job;
+        emit statusBarUpdate(QString("%1 waits for %2").arg(job->name, m_surfaceJob->name), 1);
+        return;
     }
+    startSurfaceJob(job);
+}
 
-    delete[] qmap;
-    delete[] orient;
-    delete[] d1[0];
-    delete[] d1[1];
-    delete[] d2[0];
-    delete[] d2[1];
+void DFTArea::startSurfaceJob(QSharedPointer<surfaceJob> job){
+    m_surfaceJob = job;
+    m_surfaceProgress->setLabelText(job->name + "\nPreparing the interferogram");
+    m_surfaceProgress->setValue(SURFACE_PREPARE);
+    m_surfaceWatcher->setFuture(QtConcurrent::run(runSurfaceJob, job, static_cast<QObject *>(this)));
+}
 
-    delete[] spiralRe;
-    delete[] spiralIm;
-    delete[] dir;
-    delete[] path;
-    tmp.release();
+void DFTArea::surfaceJobStage(int stage){
+    if (!m_surfaceJob)
+        return;
+    static const char *labels[] = {"Preparing the interferogram", "Vortex transform", "Unwrapping",
+                                   "Fitting zernikes"};
+    m_surfaceProgress->setLabelText(m_surfaceJob->name + "\n" + labels[stage]);
+    m_surfaceProgress->setValue(stage);
+    emit statusBarUpdate(QString("%1: %2").arg(m_surfaceJob->name, labels[stage]), 1);
+}
 
-    return phase;
-    }
-    catch (std::bad_alloc &e){
-        showmem();
-        qDebug() << QString("Error %1").arg(e.what());
-       //cv::Mat phase = cv::Mat::zeros(Size(100,100), numType);
+void DFTArea::surfaceJobPreview(){
+    if (!m_surfaceJob || m_surfaceJob->preview.empty() || m_surfaceJob->canceled.loadAcquire())
+        return;
+    emit newPreview(m_surfaceJob->previewId, m_surfaceJob->preview, m_surfaceJob->previewCrop.outside, m_surfaceJob->previewCrop.center,
+                    m_surfaceJob->name, m_surfaceJob->previewCrop.poly);
+}
 
-       return cv::Mat();
-    }
-    catch ( std::exception &e){
+void DFTArea::cancelSurfaceJob(){
+    if (m_surfaceJob)
+        m_surfaceJob->canceled.storeRelease(1);
+    m_nextSurfaceJob.clear();
+}
 
-        qDebug() << QString(" some Error %1").arg(e.what());
-       cv::Mat phase = cv::Mat::zeros(Size(0,0), numType);
-       return phase;
+void DFTArea::surfaceJobDone(){
+    QSharedPointer<surfaceJob> job = m_surfaceJob;
+    if (!job)
+        return;
+    if (job->canceled.loadAcquire()){
+        emit statusBarUpdate(QString("%1 canceled").arg(job->name), 1);
+        // keep the preview when the next job replaces it
+        if (!m_nextSurfaceJob || m_nextSurfaceJob->previewId != job->previewId)
+            emit discardPreview(job->previewId);
+        success = false;
     }
-    catch (...){
-        qDebug() << QString(" Unknown error ");
-       cv::Mat phase = cv::Mat::zeros(Size(100,100), numType);
-       return phase;
+    else if (!job->error.isEmpty() || job->result.empty()){
+        m_surfaceJob.clear();
+        m_surfaceProgress->reset();
+        emit discardPreview(job->previewId);
+        QMessageBox::warning(0,"warning", job->error.isEmpty() ? QString("Could not make the surface.") : job->error);
+        success = false;
     }
-
-}
-cv::Mat_<double> subtractPlane(cv::Mat_<double> phase, cv::Mat_<bool> mask){
-    cv::Mat_<double> coeff(3,1);
-    cv::Mat_<double> X(phase.rows * phase.cols,3);
-    cv::Mat_<double> Z(phase.rows * phase.cols,1);
-    int ndx = 0;
-    for (int y = 0; y < phase.rows; ++y){
-        for (int x = 0; x < phase.cols; ++x){
-            if (mask(y,x)){
-                Z(ndx) =  phase(y,x);
-                X(ndx,0) = x;
-                X(ndx,1) = y;
-                X(ndx++,2) = 1.;
-            }
-        }
+    else {
+        surfaceJobStage(SURFACE_FIT);
+        emit previewDone(job->previewId, job->result, job->crop.outside, job->crop.center, job->name, job->crop.poly);
+        emit statusBarUpdate(QString("%1 done").arg(job->name), 1);
+        success = true;
     }
-    cv::solve(X,Z,coeff,CV_SVD);
-    // plane generation, Z = Ax + By + C
-    // distance calculation d = Ax + By - z + C / sqrt(A^2 + B^2 + C^2)
-
+    m_surfaceJob.clear();
+    m_surfaceProgress->reset();
 
-    cv::Mat_<double> newPhase(phase.size());
-    for (int y = 0; y < phase.rows; ++y){
-        for (int x = 0; x  < phase.cols; ++x){
-            int b = (int)mask(y,x);
-            if (b == 0 ){
-                continue;
-            }
-
-            double val = x * coeff(0) + y * coeff(1) + coeff(2) - phase(y,x);
-            double z = val/sqrt(coeff(0) * coeff(0) + coeff(1) * coeff(1) + 1);
-            newPhase(y,x) = z;
-        }
+    if (m_nextSurfaceJob){
+        job = m_nextSurfaceJob;
+        m_nextSurfaceJob.clear();
+        startSurfaceJob(job);
     }
-    return newPhase;
 }
 
 // make a surface from the image using DFT and vortex transfroms.
@@ -1007,43 +743,17 @@ void DFTArea::makeSurface(){
         return;
     }
 
-    cv::Mat result = cv::Mat::zeros(phase.size(), numType);
-
-    phase.copyTo(result, m_mask);
-    phase = result.clone();
-
-    normalize(phase, phase,0,1.,CV_MINMAX, numType,m_mask);
-
-
-    cv::Mat mask = m_mask.clone();
-    mask = (255 - m_mask)/255;
-    unwrap((double *)(phase.data), (double *)(result.data), (char *)(mask.data),
-           phase.size().width, phase.size().height);
+    igramCrop crop;
+    crop.mask = m_mask;
+    crop.outside = m_outside;
+    crop.center = m_center;
+    crop.poly = m_poly;
+    cv::Mat result = unwrapIgramPhase(phase, crop, igramPipelineParams::fromSettings());
     phase.release();
-    if (!Settings2::m_dft->flipv){  // Y is normally inverted because 0 is at bottom not top of image.
-        flip(result,result,0); // flip around x axis.
-         m_outside.m_center.ry() = (result.rows-1) - m_outside.m_center.y();
-         m_center.m_center.ry() =  (result.rows-1) - m_center.m_center.y();
-    }
-    if (Settings2::m_dft->fliph){
-        flip(result,result,1); // flip around x axis.
-         m_outside.m_center.rx() = (result.cols-1) - m_outside.m_center.x();
-         m_center.m_center.rx() =  (result.cols-1) - m_center.m_center.x();
-    }
-
-    mirrorDlg *md = mirrorDlg::get_Instance();
-
-    if (md->fringeSpacing != 1.){
-        result *= md->fringeSpacing;
-    }
-
-    if (md->isEllipse()) {
-        CircleOutline t = m_outside;
-        t.enlarge(-2);
-
-        m_mask = makeMask(t,m_center, result, m_poly);
-        result = subtractPlane(result, m_mask);
-    }
+    phaseUnwrapper::forThread()->clear();
+    m_outside = crop.outside;
+    m_center = crop.center;
+    m_mask = crop.mask;
 
     if (m_vortexDebugTool->m_showUnwrapped){
 
@@ -1499,7 +1209,8 @@ qDebug() << "rec" << left << top << width << height;
     //showData("mask", mask2.clone());
     cv::Mat result = cv::Mat::zeros(phase.size(), numType);
     unwrap((double *)(phase.data), (double *)(result.data), (char *)(mask2.data),
-           phase.cols, phase.rows);
+           phase.cols, phase.rows, (unwrapMethod)Settings2::m_dft->unwrapMethod());
+    phaseUnwrapper::forThread()->clear();
 
     //showData("surface", result.clone());
     QSettings set;
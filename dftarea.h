@@ -28,6 +28,9 @@
 #include <string>
 #include "psi_dlg.h"
 #include "psiphasedisplay.h"
+#include "vortex.h"
+#include <QFutureWatcher>
+#include <QSharedPointer>
 using namespace cv;
 extern void showData(const std::string& txt, cv::Mat mat, bool useLog = false);
 extern QImage showMag(cv::Mat complexI, bool show = false, const char *title = "FFT", bool doLog = true, double gamma = 0);
@@ -37,6 +40,8 @@ extern void shiftDFT(cv::Mat &magI);
 namespace Ui {
 class DFTArea;
 }
+class QProgressDialog;
+struct surfaceJob;
 
 class DFTArea : public QWidget
 {
@@ -51,7 +56,6 @@ public:
     int m_size;
     cv::Mat fftmagI;
     cv::Mat magI;
-    cv::Mat m_dft;
     DFTTools *tools;
     QString channel;
     QString dftSizeStr;
@@ -75,6 +79,7 @@ public slots:
     void setChannel(const QString&);
     void dftCenterFilter(double v);
     void makeSurface();
+    void makeSurfaceInBackground();
     void newIgram(QImage);
     void gamma(int);
     void showResizedDlg();
@@ -83,12 +88,22 @@ public slots:
     void zoomPlus();
     void zoomMinus();
     void zoomFit();
+private slots:
+    void surfaceJobStage(int stage);
+    void surfaceJobPreview();
+    void surfaceJobDone();
+    void cancelSurfaceJob();
 signals:
     void setDftSizeVal(int);
     void selectDFTTab();
     void updateFilterSize(int);
     void newWavefront(cv::Mat, CircleOutline, CircleOutline, QString,
                       QVector<std::vector<cv::Point> >);
+    void newPreview(int, cv::Mat, CircleOutline, CircleOutline, QString,
+                      QVector<std::vector<cv::Point> >);
+    void previewDone(int, cv::Mat, CircleOutline, CircleOutline, QString,
+                      QVector<std::vector<cv::Point> >);
+    void discardPreview(int);
     void dftReady(QImage);
     void statusBarUpdate(QString, int);
 private:
@@ -109,7 +124,7 @@ private:
 
     IgramArea *igramArea;
     void paintEvent(QPaintEvent *);
-    cv::Mat grayComplexMatfromImage(QImage &img);
+    cv::Mat grayMatfromImage(QImage &img);
     void mouseMoveEvent(QMouseEvent *event);
     void mousePressEvent(QMouseEvent *event);
     void mouseReleaseEvent(QMouseEvent *event);
@@ -126,6 +141,22 @@ private:
     int m_psiRows;
     int m_psiCols;
     double zoom;
+    // log magnitude of the last spectrum as 16 bit levels between m_spectrumMin and m_spectrumMax so
+    // gamma changes only redo the tone map.  Valid for the igram, outlines and dft size in m_spectrumKey.
+    cv::Mat m_spectrumLevels;
+    double m_spectrumMin;
+    double m_spectrumMax;
+    QString m_spectrumKey;
+    QString spectrumKey();
+    QImage toneMapSpectrum(double gamma);
+    vortexParams vortexSettings(double low);
+    bool showsVortexDebug();
+    void startSurfaceJob(QSharedPointer<surfaceJob> job);
+    QFutureWatcher<void> *m_surfaceWatcher;
+    QSharedPointer<surfaceJob> m_surfaceJob;        // being processed
+    QSharedPointer<surfaceJob> m_nextSurfaceJob;    // make surface pressed again while busy
+    int m_lastPreviewId;
+    QProgressDialog *m_surfaceProgress;
 };
 
 
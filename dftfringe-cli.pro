@@ -0,0 +1,21 @@
+# dftfringe-cli: batch processing of interferograms without the gui.
+# Builds the same sources as DFTFringe with its own main.  Build it in its own build directory, for example
+#   mkdir build-cli && cd build-cli && qmake ../dftfringe-cli.pro && make
+# Run dftfringe-cli --help for the options.
+
+include(DFTFringe.pro)
+
+TARGET = dftfringe-cli
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES -= main.cpp
+SOURCES += dftfringecli.cpp
+
+macx {
+    # keep the objects apart from the gui build which uses the same DESTDIR
+    MOC_DIR = $$DESTDIR/.moc-cli
+    OBJECTS_DIR = $$DESTDIR/.obj-cli
+    RCC_DIR = $$DESTDIR/.qrc-cli
+    UI_DIR = $$DESTDIR/.ui-cli
+}
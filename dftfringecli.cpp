@@ -0,0 +1,548 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+// dftfringe-cli: turns interferograms into wave front files, zernike and metrics csv files without the gui.
+//
+//   dftfringe-cli -c mirror.json -o out igram1.jpg igram2.jpg ...
+//
+// Each interferogram needs an outline file.  By default that is the .oln file next to it with the same base
+// name as the gui writes when auto save outlines is on.  The interferograms are processed in parallel.
+//
+// To check the single precision vortex transform against double precision on a set of reference
+// interferograms run with --compare-precision.  It prints the rms differences as csv on stdout.
+//
+// Exit codes: 0 all done, 1 bad arguments, 2 mirror config could not be read, 3 some interferograms
+// failed, a csv file could not be written or --compare-precision found a difference over 1/1000 wave,
+// 4 all of the interferograms failed.
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSettings>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include "igrampipeline.h"
+#include "vortex.h"
+#include "wavefront.h"
+#include "wavefrontfile.h"
+#include "surfacemanager.h"
+#include "surfaceanalysistools.h"
+#include "zernikeprocess.h"
+#include "zernikes.h"
+#include "mirrordlg.h"
+#include "settings2.h"
+#include "spdlog/spdlog.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+enum cliExitCode {
+    CLI_OK = 0,
+    CLI_USAGE = 1,
+    CLI_CONFIG = 2,
+    CLI_SOME_FAILED = 3,
+    CLI_ALL_FAILED = 4
+};
+
+struct cliOptions {
+    igramPipelineParams params;
+    vortexParams vortex;
+    double filter;          // < 0 use the filter saved in the outline file
+    bool flipH;
+    bool annular;
+    bool comparePrecision;  // also run the other vortex precision and report the difference
+    double outputLambda;
+    QString outputDir;
+    QString outlineFile;    // used for every igram when set
+};
+
+struct cliJob {
+    QString igram;
+    QString output;
+    std::vector<double> zernikes;
+    double rms;
+    double pv;
+    double strehl;
+    double phaseDiff;       // rms radians between single and double precision wrapped phase
+    double surfaceDiff;     // rms waves between the unwrapped surfaces
+    double filter;
+    igramCrop crop;         // between the stages
+    cv::Mat surface;
+    QString error;
+    cliJob(): rms(0), pv(0), strehl(0), phaseDiff(0), surfaceDiff(0), filter(0) {}
+};
+
+// largest rms difference in waves between the single and double precision surfaces that passes --compare-precision
+static const double precisionTolerance = .001;
+
+// the zernike fit state is shared so annular fits, filling the obstruction and nulling are done one at a time.
+static QMutex fitMutex;
+
+static QString outlineFor(const QString &igram, const cliOptions &opt){
+    if (!opt.outlineFile.isEmpty())
+        return opt.outlineFile;
+    QFileInfo info(igram);
+    return info.absolutePath() + "/" + info.completeBaseName() + ".oln";
+}
+
+// rms of the difference of two unwrapped surfaces where both have data.  The piston between them is removed
+// since the unwrap can start from a different pixel.
+static double surfaceRmsDifference(const cv::Mat &a, const cv::Mat &b){
+    cv::Mat both = (a != 0) & (b != 0);
+    cv::Mat diff = a - b;
+    cv::Scalar mean,std;
+    cv::meanStdDev(diff, mean, std, both);
+    return std.val[0];
+}
+
+// read the igram and its outline and crop it for the dft.
+static void prepareIgramJob(cliJob &job, const cliOptions &opt){
+    try {
+        cv::Mat bgr = cv::imread(job.igram.toStdString(), cv::IMREAD_COLOR);
+        if (bgr.empty()){
+            job.error = "cannot read image";
+            return;
+        }
+        cv::Mat gray = bestIgramChannel(bgr);
+        bgr.release();
+        if (opt.flipH)
+            cv::flip(gray, gray, 1);
+
+        CircleOutline outside, center;
+        QVector<std::vector<cv::Point> > poly;
+        double filter = 0;
+        QString outline = outlineFor(job.igram, opt);
+        if (!readOutlineFile(outline, outside, center, filter, poly)){
+            job.error = "cannot read outline file " + outline;
+            return;
+        }
+        if (opt.filter >= 0)
+            filter = opt.filter;
+
+        job.filter = filter;
+        prepareIgram(gray, outside, center, poly, opt.params, job.crop);
+    }
+    catch (const std::bad_alloc &){
+        job.error = "out of memory";
+    }
+    catch (const cv::Exception &e){
+        job.error = QString("opencv error ") + e.what();
+    }
+}
+
+// Unwraps the vortex phase of a job.  Runs on the pool thread that made the phase.
+static void unwrapIgramJob(cliJob &job, const cv::Mat &phase, const cliOptions &opt){
+    if (phase.empty()){
+        job.error = "vortex transform failed";
+        return;
+    }
+    try {
+        igramCrop &crop = job.crop;
+        cv::Mat otherSurface;
+        if (opt.comparePrecision){
+            vortexParams other = opt.vortex;
+            other.low = job.filter;
+            other.singlePrecision = !opt.vortex.singlePrecision;
+            cv::Mat otherPhase = vortexPhase(crop.image, crop.mask, other);
+            job.phaseDiff = wrappedPhaseRmsDifference(phase, otherPhase, crop.mask);
+            igramCrop otherCrop = crop;     // the unwrap moves the outlines
+            otherSurface = unwrapIgramPhase(otherPhase, otherCrop, opt.params);
+        }
+        crop.image.release();
+        job.surface = unwrapIgramPhase(phase, crop, opt.params);
+        if (opt.comparePrecision)
+            job.surfaceDiff = surfaceRmsDifference(job.surface, otherSurface);
+    }
+    catch (const std::bad_alloc &){
+        job.error = "out of memory";
+    }
+    catch (const cv::Exception &e){
+        job.error = QString("opencv error ") + e.what();
+    }
+}
+
+// Vortex transform and unwrap of the prepared jobs.  Jobs with the same crop size and filter go through
+// vortexPhaseBatch together so they share the frequency tables.
+static void surfaceJobs(QVector<cliJob *> jobs, const cliOptions &opt){
+    while (!jobs.isEmpty()){
+        cliJob *first = jobs.front();
+        QVector<cliJob *> stack;
+        QVector<cliJob *> rest;
+        foreach(cliJob *job, jobs){
+            if (job->crop.image.size() == first->crop.image.size() && job->filter == first->filter)
+                stack << job;
+            else
+                rest << job;
+        }
+        jobs = rest;
+
+        QVector<cv::Mat> images, masks;
+        foreach(cliJob *job, stack){
+            images << job->crop.image;
+            masks << job->crop.mask;
+        }
+        vortexParams vp = opt.vortex;
+        vp.low = first->filter;
+        vortexPhaseBatch(images, masks, vp, [&stack, &opt](int i, const cv::Mat &phase){
+            unwrapIgramJob(*stack[i], phase, opt);
+        });
+    }
+}
+
+// zernike fit, metrics and the wave front file of a job with a surface.
+static void finishIgramJob(cliJob &job, const cliOptions &opt){
+    try {
+        igramCrop &crop = job.crop;
+        cv::Mat surface = job.surface;
+        job.surface.release();
+        wavefront wf;
+        wf.name = QFileInfo(job.igram).completeBaseName();
+        wf.data = surface;
+        wf.m_outside = crop.outside;
+        wf.m_inside = crop.center;
+        wf.regions = crop.poly;
+        mirrorDlg *md = mirrorDlg::get_Instance();
+        wf.diameter = md->diameter;
+        wf.roc = md->roc;
+        wf.lambda = md->lambda;
+        SurfaceManager::buildMask(&wf, 0, 0);
+
+        zernikeProcess *zp = zernikeProcess::get_Instance();
+        cv::Mat nulled;
+        if (opt.params.isEllipse){
+            nulled = wf.data;
+        }
+        else {
+            if (!opt.annular && !zp->unwrap_to_zernikes(wf)){
+                job.error = "zernike fit failed";
+                return;
+            }
+            QMutexLocker lock(&fitMutex);
+            if (opt.annular)
+                zp->unwrap_to_zernikes(wf);
+            // the gui asks about this; without anyone to ask do what it does when not asking.
+            if (md->cc != 0.0 && md->cc * wf.InputZerns[8] < 0.){
+                wf.data *= -1;
+                zp->unwrap_to_zernikes(wf);
+            }
+            zp->fillVoid(wf);
+            SurfaceManager::buildMask(&wf, 0, 0);
+            nulled = zp->null_unwrapped(wf, wf.InputZerns, zernEnables, 0, Z_TERMS);
+        }
+        job.zernikes = wf.InputZerns;
+
+        cv::Scalar mean,std;
+        cv::meanStdDev(nulled, mean, std, wf.workMask);
+        double mmin, mmax;
+        cv::minMaxIdx(nulled, &mmin, &mmax, 0, 0, wf.workMask);
+        double scale = wf.lambda/opt.outputLambda;
+        job.rms = std.val[0] * scale;
+        job.pv = (mmax - mmin) * scale;
+        job.strehl = exp(-pow(2 * M_PI * job.rms, 2));
+
+        wavefrontSaveJob save;
+        save.fileName = job.output;
+        save.data = wf.data;
+        wavefrontFileInfo &info = save.info;
+        info.outsideX = wf.m_outside.m_center.x();
+        info.outsideY = wf.m_outside.m_center.y();
+        info.outsideRadius = wf.m_outside.m_radius;
+        save.outsideRadius = wf.m_outside.m_radius;
+        save.insideRadius = wf.m_inside.m_radius;
+        if (wf.m_inside.m_radius > 0){
+            info.insideX = wf.m_inside.m_center.x();
+            info.insideY = wf.m_inside.m_center.y();
+            info.insideRadius = wf.m_inside.m_radius;
+        }
+        info.diameter = wf.diameter;
+        info.roc = wf.roc;
+        info.lambda = wf.lambda;
+        info.isEllipse = opt.params.isEllipse;
+        info.ellipseVerticalAxis = opt.params.verticalAxis;
+        info.nulled = !wf.useSANull;
+        if (!writeWavefrontFile(save))
+            job.error = "cannot write " + job.output;
+    }
+    catch (const std::bad_alloc &){
+        job.error = "out of memory";
+    }
+    catch (const cv::Exception &e){
+        job.error = QString("opencv error ") + e.what();
+    }
+}
+
+// All three stages of one group of jobs.  The groups keep only a few cropped igrams in memory at a time.
+static void processIgrams(QVector<cliJob> &jobs, int begin, int end, const cliOptions &opt){
+    QVector<cliJob *> group;
+    for (int i = begin; i < end; ++i)
+        group << &jobs[i];
+    QtConcurrent::blockingMap(group, [&opt](cliJob *&job){
+        prepareIgramJob(*job, opt);
+    });
+    QVector<cliJob *> prepared;
+    foreach(cliJob *job, group){
+        if (job->error.isEmpty())
+            prepared << job;
+    }
+    surfaceJobs(prepared, opt);
+    QtConcurrent::blockingMap(group, [&opt](cliJob *&job){
+        if (job->error.isEmpty())
+            finishIgramJob(*job, opt);
+        job->crop = igramCrop();
+    });
+}
+
+static bool writeZernikeCsv(const QString &fileName, const QVector<cliJob> &jobs){
+    QFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    QTextStream out(&f);
+    for (int z = 0; z < Z_TERMS; ++z){
+        out << "," << zernsNames[z];
+    }
+    out << Qt::endl;
+    foreach(const cliJob &job, jobs){
+        if (!job.error.isEmpty())
+            continue;
+        out << QFileInfo(job.igram).fileName();
+        for (int z = 0; z < Z_TERMS && z < (int)job.zernikes.size(); ++z){
+            out << "," << job.zernikes[z];
+        }
+        out << Qt::endl;
+    }
+    return true;
+}
+
+static bool writeMetricsCsv(const QString &fileName, const QVector<cliJob> &jobs, double outputLambda){
+    QFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    QTextStream out(&f);
+    out << "igram,wavefront,rms,pv,strehl,lambda,error" << Qt::endl;
+    foreach(const cliJob &job, jobs){
+        out << QFileInfo(job.igram).fileName() << ",";
+        if (job.error.isEmpty())
+            out << QFileInfo(job.output).fileName() << "," << job.rms << "," << job.pv << "," << job.strehl;
+        else
+            out << ",,,";
+        QString error = job.error;
+        out << "," << outputLambda << "," << error.replace(',', ';') << Qt::endl;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    // The mirror config and settings are kept by widgets so a QApplication is needed but nothing is shown.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    app.setOrganizationName("DFTFringe");
+    app.setApplicationName("dftfringe-cli");    // keep the cli settings apart from the gui
+    app.setApplicationVersion(APP_VERSION);
+
+    auto logger = spdlog::stderr_color_mt("logger");
+    logger->set_pattern("[%^%l%$] %v");
+    logger->set_level(spdlog::level::warn);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Makes wave fronts, zernike values and metrics from interferograms without the gui.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption configOption(QStringList() << "c" << "config", "Mirror config file (.json or old format).", "file");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Directory for the results.  Default is the current directory.", "dir", ".");
+    QCommandLineOption outlineOption("outline", "Outline file to use for every interferogram instead of the .oln file next to each.", "file");
+    QCommandLineOption formatOption("format", "Wave front file format wft or wftb.  Default wft.", "format", "wft");
+    QCommandLineOption dftSizeOption("dft-size", "Size the interferogram is resized to before the dft.  Default 640.", "pixels");
+    QCommandLineOption filterOption("filter", "DFT center filter radius.  Default is the one saved in the outline file.", "radius");
+    QCommandLineOption smoothOption("smooth", "Vortex orientation smoothing.  Default 9.", "value");
+    QCommandLineOption precisionOption("precision", "Vortex transform precision single or double.  Default is the DFT setting.", "precision");
+    QCommandLineOption compareOption("compare-precision", "Also run the vortex transform in the other precision and print the rms difference of "
+                                     "the wrapped phase and the surface.  Fails when a surface differs by more than 1/1000 wave.");
+    QCommandLineOption unwrapOption("unwrap", "Unwrap method exact, buckets or least-squares.  Default is the DFT setting.", "method");
+    QCommandLineOption lambdaOption("output-lambda", "Wave length in nm the metrics are reported in.  Default 550.", "nm", "550");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads", "Number of interferograms processed at once.  Default is one per core.", "count");
+    QCommandLineOption zernOption("zernikes", "Write the zernike values of all wave fronts to this csv file.", "file");
+    QCommandLineOption metricsOption("metrics", "Write rms, pv and strehl of all wave fronts to this csv file.", "file");
+    QCommandLineOption verboseOption(QStringList() << "v" << "verbose", "Print progress.");
+    parser.addOptions(QList<QCommandLineOption>() << configOption << outputOption << outlineOption << formatOption
+                      << dftSizeOption << filterOption << smoothOption << precisionOption << compareOption << unwrapOption << lambdaOption << threadsOption
+                      << zernOption << metricsOption << verboseOption);
+    parser.addPositionalArgument("igrams", "Interferogram images.", "igram...");
+    parser.process(app);
+
+    QStringList igrams = parser.positionalArguments();
+    if (igrams.isEmpty() || !parser.isSet(configOption)){
+        fputs(qPrintable(parser.helpText()), stderr);
+        return CLI_USAGE;
+    }
+    QString format = parser.value(formatOption).toLower();
+    if (format != "wft" && format != "wftb"){
+        fprintf(stderr, "unknown format %s\n", qPrintable(format));
+        return CLI_USAGE;
+    }
+    bool ok = true;
+    double outputLambda = parser.value(lambdaOption).toDouble(&ok);
+    if (!ok || outputLambda <= 0){
+        fputs("output-lambda must be a positive number\n", stderr);
+        return CLI_USAGE;
+    }
+    if (parser.isSet(verboseOption))
+        logger->set_level(spdlog::level::info);
+
+    QString configFile = parser.value(configOption);
+    if (!QFileInfo(configFile).isReadable()){
+        fprintf(stderr, "cannot read mirror config %s\n", qPrintable(configFile));
+        return CLI_CONFIG;
+    }
+    // made here on the gui thread before any worker uses them.
+    Settings2::getInstance();
+    surfaceAnalysisTools::get_Instance();
+    zernikeProcess::get_Instance();
+    mirrorDlg *md = mirrorDlg::get_Instance();
+    md->loadFile(configFile);
+    if (md->diameter <= 0 || md->lambda <= 0){
+        fprintf(stderr, "mirror config %s has no diameter or wave length\n", qPrintable(configFile));
+        return CLI_CONFIG;
+    }
+
+    cliOptions opt;
+    opt.params = igramPipelineParams::fromSettings();
+    if (parser.isSet(dftSizeOption)){
+        opt.params.dftSize = parser.value(dftSizeOption).toInt(&ok);
+        if (!ok || opt.params.dftSize < 64){
+            fputs("dft-size must be at least 64\n", stderr);
+            return CLI_USAGE;
+        }
+    }
+    opt.filter = -1;
+    if (parser.isSet(filterOption)){
+        opt.filter = parser.value(filterOption).toDouble(&ok);
+        if (!ok || opt.filter < 0){
+            fputs("filter must be a number >= 0\n", stderr);
+            return CLI_USAGE;
+        }
+    }
+    if (parser.isSet(smoothOption)){
+        opt.vortex.smooth = parser.value(smoothOption).toDouble(&ok);
+        if (!ok || opt.vortex.smooth < 0){
+            fputs("smooth must be a number >= 0\n", stderr);
+            return CLI_USAGE;
+        }
+    }
+    opt.vortex.singlePrecision = Settings2::m_dft->singlePrecision();
+    if (parser.isSet(precisionOption)){
+        QString precision = parser.value(precisionOption).toLower();
+        if (precision != "single" && precision != "double"){
+            fprintf(stderr, "unknown precision %s\n", qPrintable(precision));
+            return CLI_USAGE;
+        }
+        opt.vortex.singlePrecision = precision == "single";
+    }
+    opt.comparePrecision = parser.isSet(compareOption);
+    if (parser.isSet(unwrapOption)){
+        QString method = parser.value(unwrapOption).toLower();
+        if (method == "exact")
+            opt.params.unwrapper = UNWRAP_EXACT;
+        else if (method == "buckets")
+            opt.params.unwrapper = UNWRAP_BUCKETS;
+        else if (method == "least-squares")
+            opt.params.unwrapper = UNWRAP_LEAST_SQUARES;
+        else {
+            fprintf(stderr, "unknown unwrap method %s\n", qPrintable(method));
+            return CLI_USAGE;
+        }
+    }
+    opt.vortex.unwrapper = opt.params.unwrapper;
+    if (parser.isSet(threadsOption)){
+        int threads = parser.value(threadsOption).toInt(&ok);
+        if (!ok || threads < 1){
+            fputs("threads must be at least 1\n", stderr);
+            return CLI_USAGE;
+        }
+        QThreadPool::globalInstance()->setMaxThreadCount(threads);
+    }
+    opt.flipH = md->shouldFlipH();
+    opt.annular = md->m_useAnnular;
+    opt.outputLambda = outputLambda;
+    opt.outlineFile = parser.value(outlineOption);
+    opt.outputDir = parser.value(outputOption);
+    if (!QDir().mkpath(opt.outputDir)){
+        fprintf(stderr, "cannot make output directory %s\n", qPrintable(opt.outputDir));
+        return CLI_USAGE;
+    }
+
+    QVector<cliJob> jobs;
+    QDir outDir(opt.outputDir);
+    foreach(const QString &igram, igrams){
+        cliJob job;
+        job.igram = igram;
+        job.output = outDir.filePath(QFileInfo(igram).completeBaseName() + "." + format);
+        jobs << job;
+    }
+
+    logger->info("processing {} interferograms on {} threads", jobs.size(),
+                 QThreadPool::globalInstance()->maxThreadCount());
+    int groupSize = 4 * QThreadPool::globalInstance()->maxThreadCount();
+    for (int begin = 0; begin < jobs.size(); begin += groupSize){
+        int end = qMin(begin + groupSize, jobs.size());
+        processIgrams(jobs, begin, end, opt);
+        for (int i = begin; i < end; ++i){
+            if (jobs[i].error.isEmpty())
+                logger->info("{} -> {} rms {:.4f}", jobs[i].igram.toStdString(), jobs[i].output.toStdString(), jobs[i].rms);
+        }
+    }
+
+    int failed = 0;
+    bool checksFailed = false;     // a csv or the precision comparison, not an igram
+    foreach(const cliJob &job, jobs){
+        if (!job.error.isEmpty()){
+            ++failed;
+            logger->error("{}: {}", job.igram.toStdString(), job.error.toStdString());
+        }
+    }
+
+    if (opt.comparePrecision){
+        // igram, rms radians of the wrapped phase difference, rms waves of the surface difference
+        printf("igram,phase rms,surface rms\n");
+        double worst = 0;
+        foreach(const cliJob &job, jobs){
+            if (!job.error.isEmpty())
+                continue;
+            printf("%s,%g,%g\n", qPrintable(QFileInfo(job.igram).fileName()), job.phaseDiff, job.surfaceDiff);
+            worst = qMax(worst, job.surfaceDiff);
+        }
+        if (worst > precisionTolerance){
+            logger->error("single and double precision surfaces differ by up to {} waves rms", worst);
+            checksFailed = true;
+        }
+    }
+
+    if (parser.isSet(zernOption) && !writeZernikeCsv(parser.value(zernOption), jobs)){
+        logger->error("cannot write {}", parser.value(zernOption).toStdString());
+        checksFailed = true;
+    }
+    if (parser.isSet(metricsOption) && !writeMetricsCsv(parser.value(metricsOption), jobs, outputLambda)){
+        logger->error("cannot write {}", parser.value(metricsOption).toStdString());
+        checksFailed = true;
+    }
+
+    if (failed == 0)
+        return checksFailed ? CLI_SOME_FAILED : CLI_OK;
+    return failed >= jobs.size() ? CLI_ALL_FAILED : CLI_SOME_FAILED;
+}
@@ -38,6 +38,8 @@
 #include "simigramdlg.h"
 #include "settings2.h"
 #include "myutils.h"
+#include "igramimage.h"
+#include "igrampipeline.h"
 #include <fstream>
 #include "regionedittools.h"
 #include "colorchannel.h"
@@ -81,9 +83,6 @@ double distance(QPointF p1, QPointF p2)
     return qSqrt((p1.x() - p2.x())*(p1.x() - p2.x()) + (p1.y() - p2.y())*(p1.y() - p2.y()));
 }
 
-QImage cvMatToImage(cv::Mat out){
-    return QImage((uchar*)out.data, out.cols, out.rows,out.step1() ,QImage::Format_RGB888).copy();
-}
 IgramArea::IgramArea(QWidget *parent, void *mw)
     : QWidget(parent),m_mw(mw),m_hideOutlines(false),scale(1.),outterPcount(0), innerPcount(0),
       zoomIndex(1),dragMode(false),cropTotalDx(0), cropTotalDy(0), hasBeenCropped(false),
@@ -164,8 +163,8 @@ void IgramArea::aperatureChanged(){
 
 void IgramArea::colorChannelChanged(){
     cv::Mat bestChan = igramToGray(qImageToMat(igramColor));
-    igramGray = cvMatToImage(bestChan);
-    igramDisplay = igramGray.copy();
+    igramGray = igramMatToImage(bestChan);
+    igramDisplay = igramGray.convertToFormat(QImage::Format_RGB888);
     resizeImage();
 
 }
@@ -208,7 +207,7 @@ void IgramArea::DrawSimIgram(void){
                         QImage::QImage::Format_RGBX8888).copy();
 
     cv::Mat bestChannel = igramToGray(qImageToMat(igramColor));
-    igramGray = cvMatToImage(bestChannel);
+    igramGray = igramMatToImage(bestChannel);
     zoomIndex = 1;
     m_outsideHist.clear();
     m_centerHist.clear();
@@ -238,7 +237,9 @@ void IgramArea::DrawSimIgram(void){
 
 void IgramArea::doGamma(double gammaV){
 
-        cv::Mat mm(igramColor.height(), igramColor.width(), CV_8UC3, igramColor.bits(), igramColor.bytesPerLine());
+        // igramColor may be gray or have alpha so make a 3 channel copy first
+        QImage rgb = igramColor.convertToFormat(QImage::Format_RGB888);
+        cv::Mat mm = qImageToMat(rgb);
         mm.convertTo(mm,CV_32FC3);
         //cv::Mat bgr_planes[4];
         //split(mm,bgr_planes);
@@ -265,6 +266,11 @@ Mat IgramArea::qImageToMat(QImage &img){
     qDebug() << "format " << f << depth << planesCnt;
     cv::Mat iMat;
     switch (depth){
+        case 8: {
+            cv::Mat rgb;
+            cv::cvtColor(igramImageToMat(img), rgb, cv::COLOR_GRAY2RGB);
+            return rgb;
+        }
         case 24:
             iMat = cv::Mat(img.height(), img.width(), CV_8UC3, img.bits(), img.bytesPerLine());
             return iMat;
@@ -279,26 +285,13 @@ Mat IgramArea::qImageToMat(QImage &img){
      return iMat;
 }
 
+// Returns the one color plane used for the analysis.
 Mat IgramArea::igramToGray(cv::Mat roi){
-    // split image into three color planes
-
-    cv::Mat planes[4];
-    split( roi, planes );
-
     int maxndx = 0;
-    cv::Mat outMat;
      colorChannel &channel = *colorChannel::get_instance();
     if (channel.useAuto){
         // use the color plane with the largest std value
-        cv::Scalar mean,std;
-        cv::meanStdDev(roi,mean,std);
-        double maxStd = 0;
-        for (int i = 0; i < 3; ++i){
-            if (std[i] > maxStd){
-                maxndx = i;
-                maxStd = std[i];
-            }
-        }
+        maxndx = bestIgramChannelIndex(roi);
     }
     else {
         if (channel.useRed){
@@ -311,13 +304,12 @@ Mat IgramArea::igramToGray(cv::Mat roi){
             maxndx = 2;
         }
     }
-    for (int i = 0; i < 3; ++i){
-        planes[i] = planes[maxndx];
-    }
+    if (maxndx >= roi.channels())
+        maxndx = 0;
     m_usingChannel = maxndx;
     static const char *colorNames[] = {"red","green","blue"};
-    cv::Mat gray;
-    cv::merge(planes, 3, gray);
+    cv::Mat gray = igramBufferPool::get_Instance()->acquire(roi.rows, roi.cols, CV_8UC1);
+    cv::extractChannel(roi, gray, maxndx);
     emit imageSize(QString("%1 X %2 using %3 channel").arg(igramColor.size().width()).arg(
                                      igramColor.size().height()).arg(colorNames[maxndx]));
     return gray;
@@ -582,9 +574,7 @@ void IgramArea::findCenterHole(){
 
     emit statusBarUpdate("Searching for center hole phase 1",2);
     QImage img = igramGray;
-    cv::Mat igram(img.height(), img.width(), CV_8UC3, img.bits(), img.bytesPerLine());
-    cv::Mat gray;
-    cvtColor(igram, gray, cv::COLOR_BGR2GRAY);
+    cv::Mat gray = igramImageToMat(img);
     double scale = 250./img.height();
     if (scale > 1.)
         scale = 1.;
@@ -771,9 +761,7 @@ void IgramArea::findOutline(){
     m_searching_outside = true;
     int searchMargin = set.value("outlineScanRange",20).toInt();
     QImage img = igramGray;
-    cv::Mat igram(img.height(), img.width(), CV_8UC3, img.bits(), img.bytesPerLine());
-    cv::Mat gray;
-    cvtColor(igram, gray, cv::COLOR_BGR2GRAY);
+    cv::Mat gray = igramImageToMat(img);
     gray = toSobel(gray);
 
     double scale = 1.;
@@ -987,18 +975,22 @@ bool IgramArea::openImage(const QString &fileName, bool showBoundary)
     }
 
     QApplication::setOverrideCursor(Qt::WaitCursor);
-    QImage loadedImage;
-    if (!loadedImage.load(fileName)) {
-        QMessageBox::warning(NULL,"","Image "+fileName + " could not be read.");
-        QApplication::restoreOverrideCursor();
-        return false;
+    igramBufferPool &pool = *igramBufferPool::get_Instance();
+    // decoded once into a pooled buffer.  Every image after this is a view of it or of the gray plane.
+    cv::Mat rgb;
+    if (!decodeIgramFile(fileName, rgb)){
+        // formats only Qt can read
+        QImage loadedImage;
+        if (!loadedImage.load(fileName)) {
+            QMessageBox::warning(NULL,"","Image "+fileName + " could not be read.");
+            QApplication::restoreOverrideCursor();
+            return false;
+        }
+        rgb = pool.acquire(loadedImage.height(), loadedImage.width(), CV_8UC3);
+        igramImageToMat(loadedImage.convertToFormat(QImage::Format_RGB888)).copyTo(rgb);
     }
-    // convert image to 3 channel image
-    if (loadedImage.format() != QImage::Format_RGB888)
-        loadedImage = loadedImage.convertToFormat(QImage::Format_RGB888);
 
     if (Settings2::getInstance()->m_igram->m_removeDistortion){
-        cv::Mat raw = imread(fileName.toStdString().c_str());
         QStringList parms = Settings2::getInstance()->m_igram->m_lenseParms;
         Mat camera = Mat::zeros(3,3,CV_64FC1);
         Mat distortion =Mat::zeros(1,5, CV_64FC1);
@@ -1010,28 +1002,20 @@ bool IgramArea::openImage(const QString &fileName, bool showBoundary)
         }
 
 
-        camera.at<double>(0,2) = raw.cols/2;
-        camera.at<double>(1,2) = raw.rows/2;
+        camera.at<double>(0,2) = rgb.cols/2;
+        camera.at<double>(1,2) = rgb.rows/2;
         camera.at<double>(2,2) = 1.;
         std::stringstream ss;
         ss  << "camera "<< camera << std::endl <<"distortion " << distortion;
         qDebug() << ss.str().c_str();
-        Mat corrected;
-
-        Mat view, rview, map1, map2;
-
-        undistort(raw, corrected, camera, distortion);
-
-        cvtColor(corrected,corrected, COLOR_BGR2RGB);
-        loadedImage =  QImage((uchar*)corrected.data,
-                              corrected.cols,
-                              corrected.rows,
-                              corrected.step,
-                              QImage::Format_RGB888).copy();
 
+        Mat corrected = pool.acquire(rgb.rows, rgb.cols, CV_8UC3);
+        undistort(rgb, corrected, camera, distortion);
+        pool.release(rgb);
+        rgb = corrected;
     }
     if (mirrorDlg::get_Instance()->shouldFlipH())
-        loadedImage = loadedImage.mirrored(true,false);
+        cv::flip(rgb, rgb, 1);
     hasBeenCropped = false;
     needToConvertBGR = true;
     //m_demo->hide();
@@ -1039,16 +1023,17 @@ bool IgramArea::openImage(const QString &fileName, bool showBoundary)
     zoomIndex = 1;
     if (m_zoomMode == EDGEZOOM)
         zoomIndex = 2;
-    igramColor = loadedImage;
+    igramColor = igramMatToImage(rgb);
+    rgb.release();
 
 
 
     if (m_doGamma)
         doGamma(m_gammaValue);
     cv::Mat bestChan = igramToGray(qImageToMat(igramColor));
-    igramGray = cvMatToImage(bestChan);
+    igramGray = igramMatToImage(bestChan);
 
-    igramDisplay = igramGray.copy();
+    igramDisplay = igramGray.convertToFormat(QImage::Format_RGB888);
 /*
     QLabel *testl = new QLabel(0);
     testl->setPixmap(QPixmap::fromImage(igramDisplay));
@@ -1056,9 +1041,9 @@ bool IgramArea::openImage(const QString &fileName, bool showBoundary)
     */
 
     m_outsideHist.clear();
-    m_outsideHist.push(igramGray, m_outside);
+    m_outsideHist.push(igramColor, m_outside);
     m_centerHist.clear();
-    m_centerHist.push(igramGray,m_center);
+    m_centerHist.push(igramColor,m_center);
     modified = false;
     QSettings set;
     gscrollArea->setWidgetResizable(true);
@@ -1625,11 +1610,11 @@ void IgramArea::mouseReleaseEvent(QMouseEvent *event)
     if (event->button() == Qt::LeftButton && (scribbling || dragMode)) {
         if (m_current_boundry == OutSideOutline){
             m_outside = CircleOutline(m_OutterP1,m_OutterP2);
-            m_outsideHist.push(igramGray, m_outside);
+            m_outsideHist.push(igramColor, m_outside);
         }
         else if (m_current_boundry == CenterOutline){
             m_center = CircleOutline(m_innerP1,m_innerP2);
-            m_centerHist.push(igramGray, m_center);
+            m_centerHist.push(igramColor, m_center);
         }
         emit enableShiftButtons(true);
     }
@@ -1681,7 +1666,8 @@ void IgramArea::drawBoundary()
 
 {
 
-    m_withOutlines = colorChannel::get_instance()->m_showOriginalColorImage ? igramColor:igramGray;
+    m_withOutlines = colorChannel::get_instance()->m_showOriginalColorImage ? igramColor:
+                                                                             igramGray.convertToFormat(QImage::Format_RGB888);
 
     QPainter painter(&m_withOutlines);
     painter.drawImage(0,0,m_withOutlines);
@@ -1879,7 +1865,8 @@ void IgramArea::resizeImage()
         }
 
 
-        igramDisplay = resized;
+        // only the display sized image has color for the outlines
+        igramDisplay = resized.convertToFormat(QImage::Format_RGB888);
         painter.drawImage(QPoint(0, 0), igramDisplay);
         //scale = fitScale = (double)parentWidget()->height()/(double)igramImage.height();
     } catch (...) {
@@ -2073,8 +2060,8 @@ void IgramArea::crop() {
     m_innerP2 = m_center.m_p2.m_p;
     resizeImage();
 
-    m_outsideHist.push(igramGray, m_outside);
-    m_centerHist.push(igramGray, m_center);
+    m_outsideHist.push(igramColor, m_outside);
+    m_centerHist.push(igramColor, m_center);
     hasBeenCropped = true;
     scale = fitScale = (double)parentWidget()->height()/(double)igramGray.height();
     update();
@@ -2243,7 +2230,7 @@ void IgramArea::loadOutlineFileOldV6(QString fileName){
         computeEdgeRadius();
         drawBoundary();
     }
-    m_outsideHist.push(igramGray,m_outside);
+    m_outsideHist.push(igramColor,m_outside);
     emit enableShiftButtons(true);
 
     QString msg2 = QString("center= %1,%2 radius = %3 scale =%4").arg(
@@ -2431,13 +2418,13 @@ void IgramArea::shiftoutline(QPointF p) {
         m_outside.translate(p);
         m_OutterP1 = m_outside.m_p1.m_p;
         m_OutterP2 = m_outside.m_p2.m_p;
-        m_outsideHist.push(igramGray, m_outside);
+        m_outsideHist.push(igramColor, m_outside);
     }
     else if (m_current_boundry == CenterOutline){
         m_center.translate(p);
         m_innerP1 = m_center.m_p1.m_p;
         m_innerP2 = m_center.m_p2.m_p;
-        m_centerHist.push(igramGray, m_center);
+        m_centerHist.push(igramColor, m_center);
     }
     drawBoundary();
 
@@ -2548,7 +2535,7 @@ void IgramArea::gammaChanged(bool checked, double value){
         doGamma(1./m_lastGamma);
         m_lastGamma = 0;
     }
-    igramDisplay = igramGray.copy();
+    igramDisplay = igramGray.convertToFormat(QImage::Format_RGB888);
     resizeImage();
     if (m_outside.m_radius > 0.)
         emit upateColorChannels(qImageToMat(igramColor));
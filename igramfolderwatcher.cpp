@@ -0,0 +1,150 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#include "igramfolderwatcher.h"
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QImageReader>
+#include <QSettings>
+#include <QDebug>
+
+// how often files that are still being written are checked
+#define SETTLE_INTERVAL_MS 500
+
+igramFolderWatcher::igramFolderWatcher(QObject *parent) :
+    QObject(parent)
+{
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, SIGNAL(directoryChanged(QString)), this, SLOT(scan()));
+    m_timer = new QTimer(this);
+    m_timer->setInterval(SETTLE_INTERVAL_MS);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(checkCandidates()));
+    foreach (const QByteArray &format, QImageReader::supportedImageFormats())
+        m_nameFilters << "*." + QString(format);
+    QSettings set;
+    m_maxPending = set.value("watchFolderQueueSize", 8).toInt();
+}
+
+bool igramFolderWatcher::start(const QString &dir){
+    stop();
+    if (!QFileInfo(dir).isDir() || !m_watcher->addPath(dir))
+        return false;
+    m_dir = dir;
+    // only files that show up after this are processed
+    QDir d(m_dir);
+    foreach (const QString &name, d.entryList(m_nameFilters, QDir::Files))
+        m_seen.insert(d.filePath(name));
+    return true;
+}
+
+void igramFolderWatcher::stop(){
+    if (!m_dir.isEmpty())
+        m_watcher->removePath(m_dir);
+    m_timer->stop();
+    m_dir.clear();
+    m_seen.clear();
+    m_candidates.clear();
+    m_queue.clear();
+}
+
+bool igramFolderWatcher::isWatching() const{
+    return !m_dir.isEmpty();
+}
+
+QString igramFolderWatcher::directory() const{
+    return m_dir;
+}
+
+QString igramFolderWatcher::takeNext(){
+    if (m_queue.isEmpty())
+        return QString();
+    return m_queue.dequeue();
+}
+
+int igramFolderWatcher::pending() const{
+    return m_queue.size();
+}
+
+int igramFolderWatcher::maxPending() const{
+    return m_maxPending;
+}
+
+void igramFolderWatcher::setMaxPending(int n){
+    m_maxPending = qMax(1, n);
+    QSettings set;
+    set.setValue("watchFolderQueueSize", m_maxPending);
+}
+
+void igramFolderWatcher::scan(){
+    if (m_dir.isEmpty())
+        return;
+    QDir d(m_dir);
+    foreach (const QFileInfo &info, d.entryInfoList(m_nameFilters, QDir::Files)){
+        QString path = info.filePath();
+        if (m_seen.contains(path) || m_candidates.contains(path))
+            continue;
+        candidate c;
+        c.size = info.size();
+        c.modified = info.lastModified();
+        m_candidates.insert(path, c);
+    }
+    if (!m_candidates.isEmpty() && !m_timer->isActive())
+        m_timer->start();
+}
+
+// A file is complete when it has not changed since the last check and can be opened.
+void igramFolderWatcher::checkCandidates(){
+    bool ready = false;
+    QHash<QString, candidate>::iterator it = m_candidates.begin();
+    while (it != m_candidates.end()){
+        QFileInfo info(it.key());
+        if (!info.exists()){
+            it = m_candidates.erase(it);
+            continue;
+        }
+        qint64 size = info.size();
+        QDateTime modified = info.lastModified();
+        if (size == 0 || size != it->size || modified != it->modified){
+            it->size = size;
+            it->modified = modified;
+            ++it;
+            continue;
+        }
+        QFile f(it.key());
+        if (!f.open(QIODevice::ReadOnly)){     // still locked by the writer on Windows
+            ++it;
+            continue;
+        }
+        f.close();
+        m_seen.insert(it.key());
+        m_queue.enqueue(it.key());
+        while (m_queue.size() > m_maxPending){
+            QString old = m_queue.dequeue();
+            qDebug() << "watch folder queue full, dropping" << old;
+            emit dropped(old);
+        }
+        it = m_candidates.erase(it);
+        ready = true;
+    }
+    if (m_candidates.isEmpty())
+        m_timer->stop();
+    if (ready)
+        emit igramReady();
+}
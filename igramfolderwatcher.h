@@ -0,0 +1,72 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#ifndef IGRAMFOLDERWATCHER_H
+#define IGRAMFOLDERWATCHER_H
+
+#include <QObject>
+#include <QQueue>
+#include <QHash>
+#include <QSet>
+#include <QDateTime>
+#include <QStringList>
+
+class QFileSystemWatcher;
+class QTimer;
+
+// Watches a directory for new interferogram images written by a capture station.  A new file is
+// queued once its size and time stamp have stopped changing so half written images are never read.
+// The queue is bounded; when a burst of captures overflows it the oldest waiting files are dropped.
+class igramFolderWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit igramFolderWatcher(QObject *parent = 0);
+    bool start(const QString &dir);
+    void stop();
+    bool isWatching() const;
+    QString directory() const;
+    // next completed image or an empty string
+    QString takeNext();
+    int pending() const;
+    int maxPending() const;
+    void setMaxPending(int n);
+
+signals:
+    void igramReady();
+    void dropped(QString fileName);
+
+private slots:
+    void scan();
+    void checkCandidates();
+
+private:
+    struct candidate {
+        qint64 size;
+        QDateTime modified;
+    };
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_timer;
+    QString m_dir;
+    QStringList m_nameFilters;
+    QSet<QString> m_seen;
+    QHash<QString, candidate> m_candidates;
+    QQueue<QString> m_queue;
+    int m_maxPending;
+};
+
+#endif // IGRAMFOLDERWATCHER_H
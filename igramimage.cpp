@@ -0,0 +1,118 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#include "igramimage.h"
+#include <QFile>
+#include <QImageReader>
+#include <QMutexLocker>
+
+igramBufferPool *igramBufferPool::get_Instance(){
+    static igramBufferPool m_Instance;
+    return &m_Instance;
+}
+
+// enough for the color and gray planes of the current and the previous interferogram
+igramBufferPool::igramBufferPool(): m_maxFree(4)
+{
+}
+
+cv::Mat igramBufferPool::acquire(int rows, int cols, int type){
+    QMutexLocker lock(&m_mutex);
+    for (int i = 0; i < m_free.size(); ++i){
+        const cv::Mat &m = m_free[i];
+        if (m.rows == rows && m.cols == cols && m.type() == type){
+            return m_free.takeAt(i);
+        }
+    }
+    lock.unlock();
+    return cv::Mat(rows, cols, type);
+}
+
+// Only buffers nobody else is using are kept.
+void igramBufferPool::release(const cv::Mat &m){
+    if (m.empty() || m.u == 0 || m.u->refcount != 1 || !m.isContinuous())
+        return;
+    QMutexLocker lock(&m_mutex);
+    m_free.append(m);
+    while (m_free.size() > m_maxFree)
+        m_free.removeFirst();
+}
+
+bool decodeIgramFile(const QString &fileName, cv::Mat &rgb){
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    // the compressed file is small next to the decoded frame
+    QByteArray bytes = file.readAll();
+    file.close();
+    if (bytes.isEmpty())
+        return false;
+
+    // the header gives the size so the pixels can be decoded straight into a pooled buffer
+    cv::Mat dst;
+    QSize size = QImageReader(fileName).size();
+    if (size.isValid())
+        dst = igramBufferPool::get_Instance()->acquire(size.height(), size.width(), CV_8UC3);
+    try {
+        cv::Mat buf(1, bytes.size(), CV_8U, bytes.data());
+        cv::imdecode(buf, cv::IMREAD_COLOR | cv::IMREAD_IGNORE_ORIENTATION, &dst);
+    }
+    catch (const cv::Exception &){
+        return false;
+    }
+    if (dst.empty())
+        return false;
+    cv::cvtColor(dst, dst, cv::COLOR_BGR2RGB);
+    rgb = dst;
+    return true;
+}
+
+static void releaseIgramBuffer(void *info){
+    cv::Mat *m = static_cast<cv::Mat *>(info);
+    igramBufferPool::get_Instance()->release(*m);
+    delete m;
+}
+
+QImage igramMatToImage(const cv::Mat &m){
+    QImage::Format format;
+    switch (m.type()){
+    case CV_8UC1:
+        format = QImage::Format_Grayscale8;
+        break;
+    case CV_8UC3:
+        format = QImage::Format_RGB888;
+        break;
+    default:
+        return QImage();
+    }
+    cv::Mat *owner = new cv::Mat(m);
+    return QImage(owner->data, owner->cols, owner->rows, (int)owner->step, format, releaseIgramBuffer, owner);
+}
+
+cv::Mat igramImageToMat(const QImage &img){
+    uchar *bits = const_cast<uchar *>(img.constBits());
+    switch (img.format()){
+    case QImage::Format_Grayscale8:
+        return cv::Mat(img.height(), img.width(), CV_8UC1, bits, img.bytesPerLine());
+    case QImage::Format_RGB888:
+        return cv::Mat(img.height(), img.width(), CV_8UC3, bits, img.bytesPerLine());
+    default: {
+        QImage rgb = img.convertToFormat(QImage::Format_RGB888);
+        return cv::Mat(rgb.height(), rgb.width(), CV_8UC3, (uchar *)rgb.constBits(), rgb.bytesPerLine()).clone();
+    }
+    }
+}
@@ -0,0 +1,49 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#ifndef IGRAMIMAGE_H
+#define IGRAMIMAGE_H
+#include <opencv2/opencv.hpp>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+// Interferograms are decoded once into cv::Mat buffers taken from a small pool.  The QImages that
+// IgramArea keeps are views of those buffers and give them back to the pool when the last copy of the
+// view goes away, so loading a series of same sized camera frames reuses the same memory.
+class igramBufferPool {
+public:
+    static igramBufferPool *get_Instance();
+    cv::Mat acquire(int rows, int cols, int type);
+    void release(const cv::Mat &m);
+private:
+    igramBufferPool();
+    QMutex m_mutex;
+    QList<cv::Mat> m_free;
+    int m_maxFree;
+};
+
+// Decodes the file into an 8 bit RGB buffer from the pool.  Exif orientation is ignored to match QImage.
+bool decodeIgramFile(const QString &fileName, cv::Mat &rgb);
+// QImage view of an 8 bit RGB or single channel Mat.  No pixels are copied; the view keeps m alive.
+QImage igramMatToImage(const cv::Mat &m);
+// cv::Mat header on the pixels of an RGB888 or Grayscale8 image.  Other formats are converted.
+// The header is only valid while img is.
+cv::Mat igramImageToMat(const QImage &img);
+
+#endif // IGRAMIMAGE_H
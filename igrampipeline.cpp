@@ -0,0 +1,329 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#include "igrampipeline.h"
+#include "punwrap.h"
+#include "mirrordlg.h"
+#include "settings2.h"
+#include "myutils.h"
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QSettings>
+
+igramPipelineParams::igramPipelineParams():
+    dftSize(640), diameter(0), aperatureReduction(0), isEllipse(false), verticalAxis(0),
+    fringeSpacing(1.), flipv(false), fliph(false), unwrapper(UNWRAP_EXACT)
+{
+}
+
+igramPipelineParams igramPipelineParams::fromSettings(){
+    igramPipelineParams p;
+    mirrorDlg &md = *mirrorDlg::get_Instance();
+    QSettings set;
+    p.dftSize = set.value("DFTSize", 640).toInt();
+    p.diameter = md.diameter;
+    p.aperatureReduction = md.m_aperatureReductionEnabled ? md.aperatureReduction : 0.;
+    p.isEllipse = md.isEllipse();
+    p.verticalAxis = md.m_verticalAxis;
+    p.fringeSpacing = md.fringeSpacing;
+    p.flipv = Settings2::m_dft->flipv;
+    p.fliph = Settings2::m_dft->fliph;
+    p.unwrapper = (unwrapMethod)Settings2::m_dft->unwrapMethod();
+    return p;
+}
+
+igramCrop::igramCrop(): width(0)
+{
+}
+
+// The color plane with the largest spread.  The spread comes from histograms of every n'th pixel
+// in both directions, about 256k samples, so large camera frames are not read in full.
+int bestIgramChannelIndex(const cv::Mat &image){
+    CV_Assert(image.depth() == CV_8U);
+    int channels = image.channels();
+    if (channels == 1 || image.empty())
+        return 0;
+    int colors = std::min(channels, 3);     // not alpha
+    int step = std::max(1, (int)std::sqrt((double)image.total() / (512. * 512.)));
+    std::vector<int64> hist(3 * 256, 0);
+    for (int y = 0; y < image.rows; y += step){
+        const uchar *row = image.ptr<uchar>(y);
+        for (int x = 0; x < image.cols; x += step){
+            const uchar *px = row + x * channels;
+            for (int c = 0; c < colors; ++c)
+                ++hist[c * 256 + px[c]];
+        }
+    }
+    int maxndx = 0;
+    double maxVar = -1;
+    for (int c = 0; c < colors; ++c){
+        double n = 0, sum = 0, sumSq = 0;
+        for (int v = 0; v < 256; ++v){
+            double cnt = (double)hist[c * 256 + v];
+            n += cnt;
+            sum += cnt * v;
+            sumSq += cnt * v * v;
+        }
+        double mean = sum / n;
+        double var = sumSq / n - mean * mean;
+        if (var > maxVar){
+            maxndx = c;
+            maxVar = var;
+        }
+    }
+    return maxndx;
+}
+
+cv::Mat bestIgramChannel(const cv::Mat &bgr){
+    if (bgr.channels() == 1)
+        return bgr;
+    cv::Mat plane;
+    cv::extractChannel(bgr, plane, bestIgramChannelIndex(bgr));
+    return plane;
+}
+
+cv::Mat makeIgramMask(const CircleOutline &outside, const CircleOutline &center, cv::Size size,
+                      const QVector<std::vector<cv::Point> > &poly, bool isEllipse, double axisRatio){
+    int width = size.width;
+    int height = size.height;
+    double radm = ceil(outside.m_radius) + 1;
+    double rady = radm;
+    if (isEllipse)
+        rady = radm * axisRatio;
+    double rado = center.m_radius;
+    double cx = outside.m_center.x();
+    double cy = outside.m_center.y();
+    cv::Mat mask = cv::Mat::zeros(height,width,CV_8UC1);
+
+    for (int y = 0; y < height; ++y){
+        for (int x = 0; x < width; ++x){
+            double dx = (double)(x - cx)/(radm);
+            double dy = (double)(y - cy)/(rady);
+            if (sqrt(dx * dx + dy * dy) <= 1.)
+                mask.at<uchar>(y,x) = 255;
+        }
+    }
+    cx = center.m_center.x();
+    cy = center.m_center.y();
+    if (rado > 0) {
+        for (int y = 0; y < height; ++y){
+            for (int x = 0; x < width; ++x){
+                double dx = (double)(x - (cx))/(rado);
+                double dy = (double)(y - (cy))/(rado);
+                if (sqrt(dx * dx + dy * dy) < 1.)
+                    mask.at<uchar>(y,x) = 0;
+            }
+        }
+    }
+    for (int n = 0; n < poly.size(); ++n){
+        const std::vector<cv::Point> &points = poly[n];
+        if (points.size() == 0)
+            continue;
+        for (std::size_t j = 0; j < points.size()-1; ++j){
+            cv::line(mask, points[j], points[j+1], cv::Scalar(0));
+        }
+        const cv::Point* ppt[1] = { &points[0]};
+        int npt[] = { static_cast<int>(points.size()) };
+
+        cv::fillPoly( mask, ppt, npt, 1, cv::Scalar(0), 8 );
+    }
+    return mask;
+}
+
+bool readOutlineFile(const QString &fileName, CircleOutline &outside, CircleOutline &center,
+                     double &dftFilter, QVector<std::vector<cv::Point> > &poly){
+    QFile loadFile(fileName);
+    if (!loadFile.open(QIODevice::ReadOnly))
+        return false;
+    QJsonParseError err;
+    QJsonDocument loadDoc(QJsonDocument::fromJson(loadFile.readAll(), &err));
+    if (loadDoc.isNull())
+        return false;   // old binary outline files are not supported here
+
+    outside = CircleOutline(loadDoc["outside_outline"].toObject());
+    center = CircleOutline(loadDoc["inside_outline"].toObject());
+    dftFilter = loadDoc["dft_filter_radius"].toDouble();
+    poly.clear();
+    QJsonArray jregions = loadDoc["regions"].toArray();
+    for (int i=0; i < jregions.size(); ++i) {
+        QJsonArray jpoly = jregions[i].toArray();
+        poly.push_back(std::vector< cv::Point>());
+        for (int j=0; j< jpoly.size(); ++j) {
+            QJsonObject jpoint = jpoly[j].toObject();
+            poly.back().push_back(cv::Point(jpoint["x"].toDouble(), jpoint["y"].toDouble()));
+        }
+    }
+    return outside.m_radius > 0;
+}
+
+// crop a square around the outline, resize it to the dft size and remove the mean.
+void prepareIgram(const cv::Mat &gray, const CircleOutline &outside, const CircleOutline &center,
+                  const QVector<std::vector<cv::Point> > &polygons, const igramPipelineParams &p,
+                  igramCrop &crop){
+    double centerX = outside.m_center.x();
+    double centerY = outside.m_center.y();
+
+    double pixelsPermm =(outside.m_radius/(p.diameter/2.));
+    double reduction = p.aperatureReduction * pixelsPermm;
+
+    double rad = outside.m_radius - reduction;
+
+    double left = centerX - rad;
+    double top = centerY - rad;
+    top = std::max(top,0.);
+    left = std::max(left,0.);
+    int width = 2. * (rad);
+    int height = width;
+    width = std::min(width, gray.cols);
+    height = std::min(height, gray.rows);
+    crop.width = width;
+
+    // new center because of crop
+    double xCenterShift = centerX - left;
+    double yCenterShift = centerY - top;
+
+    cv::Mat roi = gray(cv::Rect((int)left,(int)top,(int)width,(int)height)).clone();
+
+    double centerDx = centerX - center.m_center.x();
+    double centerDy = centerY - center.m_center.y();
+
+    roi.convertTo(roi,CV_32F);
+    double scaleFactor = (double)p.dftSize/roi.cols;
+
+    crop.outside = CircleOutline(QPointF(xCenterShift,yCenterShift), rad);
+    crop.center = CircleOutline(QPointF(xCenterShift - centerDx, yCenterShift - centerDy),
+                             center.m_radius);
+
+    if (scaleFactor < 1.){
+
+        cv::resize(roi,roi, cv::Size(0,0), scaleFactor, scaleFactor,cv::INTER_AREA);
+        double roicx = (roi.cols-1)/2.;
+        double roicy = (roi.rows-1)/2.;
+        crop.outside = CircleOutline(QPointF(roicx,roicy),roicx);
+        crop.center = CircleOutline(QPointF((roicx - centerDx * scaleFactor), (roicy - centerDy * scaleFactor)),
+                                 crop.center.m_radius * scaleFactor);
+    }
+    else {
+        scaleFactor = 1.;
+    }
+    crop.poly.clear();
+    for (int n = 0; n < polygons.size(); ++n){
+        crop.poly.append(std::vector< cv::Point>());
+        for (unsigned int i = 0; i < polygons[n].size(); ++i){
+            int x = round((polygons[n][i].x - left) * scaleFactor);
+            int y = round((polygons[n][i].y - top) * scaleFactor);
+
+            // make sure x and y values of regions are inside our matrix
+            if (x < 0)
+                x=0;
+            if (x >= roi.cols)
+                x=roi.cols-1;
+            if (y < 0)
+                y=0;
+            if (y >= roi.rows)
+                y = roi.rows-1;
+
+            crop.poly.back().push_back(cv::Point(x,y));
+        }
+    }
+
+    cv::Scalar mean =  cv::mean(roi);
+    cv::Mat padded = roi - mean[0];
+
+    crop.mask = makeIgramMask(crop.outside, crop.center, padded.size(), crop.poly,
+                              p.isEllipse, p.verticalAxis/p.diameter);
+    crop.image = cv::Mat::zeros(padded.size(), CV_32F);
+    padded.copyTo(crop.image, crop.mask);
+    mean =  cv::mean(crop.image,crop.mask);
+
+    crop.image -= mean;
+}
+
+cv::Mat_<double> subtractPlane(cv::Mat_<double> phase, cv::Mat_<bool> mask){
+    cv::Mat_<double> coeff(3,1);
+    cv::Mat_<double> X(phase.rows * phase.cols,3);
+    cv::Mat_<double> Z(phase.rows * phase.cols,1);
+    int ndx = 0;
+    for (int y = 0; y < phase.rows; ++y){
+        for (int x = 0; x < phase.cols; ++x){
+            if (mask(y,x)){
+                Z(ndx) =  phase(y,x);
+                X(ndx,0) = x;
+                X(ndx,1) = y;
+                X(ndx++,2) = 1.;
+            }
+        }
+    }
+    cv::solve(X,Z,coeff,cv::DECOMP_SVD);
+    // plane generation, Z = Ax + By + C
+    // distance calculation d = Ax + By - z + C / sqrt(A^2 + B^2 + C^2)
+
+
+    cv::Mat_<double> newPhase(phase.size());
+    for (int y = 0; y < phase.rows; ++y){
+        for (int x = 0; x  < phase.cols; ++x){
+            int b = (int)mask(y,x);
+            if (b == 0 ){
+                continue;
+            }
+
+            double val = x * coeff(0) + y * coeff(1) + coeff(2) - phase(y,x);
+            double z = val/sqrt(coeff(0) * coeff(0) + coeff(1) * coeff(1) + 1);
+            newPhase(y,x) = z;
+        }
+    }
+    return newPhase;
+}
+
+cv::Mat unwrapIgramPhase(const cv::Mat &wrapped, igramCrop &crop, const igramPipelineParams &p){
+    cv::Mat result = cv::Mat::zeros(wrapped.size(), numType);
+
+    wrapped.copyTo(result, crop.mask);
+    cv::Mat phase = result.clone();
+
+    cv::normalize(phase, phase,0,1.,cv::NORM_MINMAX, numType,crop.mask);
+
+    cv::Mat mask = (255 - crop.mask)/255;
+    unwrap((double *)(phase.data), (double *)(result.data), (char *)(mask.data),
+           phase.size().width, phase.size().height, p.unwrapper);
+    phase.release();
+    if (!p.flipv){  // Y is normally inverted because 0 is at bottom not top of image.
+        cv::flip(result,result,0); // flip around x axis.
+        crop.outside.m_center.ry() = (result.rows-1) - crop.outside.m_center.y();
+        crop.center.m_center.ry() =  (result.rows-1) - crop.center.m_center.y();
+    }
+    if (p.fliph){
+        cv::flip(result,result,1); // flip around x axis.
+        crop.outside.m_center.rx() = (result.cols-1) - crop.outside.m_center.x();
+        crop.center.m_center.rx() =  (result.cols-1) - crop.center.m_center.x();
+    }
+
+    if (p.fringeSpacing != 1.){
+        result *= p.fringeSpacing;
+    }
+
+    if (p.isEllipse) {
+        CircleOutline t = crop.outside;
+        t.enlarge(-2);
+
+        crop.mask = makeIgramMask(t, crop.center, result.size(), crop.poly, p.isEllipse,
+                                  p.verticalAxis/p.diameter);
+        result = subtractPlane(result, crop.mask);
+    }
+    return result;
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#ifndef IGRAMPIPELINE_H
+#define IGRAMPIPELINE_H
+#include <opencv2/opencv.hpp>
+#include <QVector>
+#include <QString>
+#include "Circleoutline.h"
+#include "punwrap.h"
+
+// The steps that turn an interferogram into a surface without any widgets.  DFTArea uses them
+// for the gui and dftfringe-cli uses them for batch processing.  The values that come from the
+// mirror config and the settings are copied into igramPipelineParams first so the steps can be
+// run on worker threads.
+struct igramPipelineParams {
+    int dftSize;
+    double diameter;
+    double aperatureReduction;  // mm, 0 when aperture reduction is off
+    bool isEllipse;
+    double verticalAxis;
+    double fringeSpacing;
+    bool flipv;
+    bool fliph;
+    unwrapMethod unwrapper;
+    igramPipelineParams();
+    // from the mirror config and dft settings.  Gui thread only.
+    static igramPipelineParams fromSettings();
+};
+
+// The part of an interferogram inside the outline ready for the dft.
+struct igramCrop {
+    cv::Mat image;          // CV_32F mean removed and zero outside the mask
+    cv::Mat mask;
+    CircleOutline outside;
+    CircleOutline center;
+    QVector<std::vector<cv::Point> > poly;
+    int width;              // of the crop before it was resized to the dft size
+    igramCrop();
+};
+
+// index of the color channel of an 8 bit image with the most contrast.
+int bestIgramChannelIndex(const cv::Mat &image);
+// single channel 8 bit image of the color channel with the most contrast.
+cv::Mat bestIgramChannel(const cv::Mat &bgr);
+cv::Mat makeIgramMask(const CircleOutline &outside, const CircleOutline &center, cv::Size size,
+                      const QVector<std::vector<cv::Point> > &poly, bool isEllipse, double axisRatio);
+// json .oln outline file as written by IgramArea::writeOutlines.
+bool readOutlineFile(const QString &fileName, CircleOutline &outside, CircleOutline &center,
+                     double &dftFilter, QVector<std::vector<cv::Point> > &poly);
+void prepareIgram(const cv::Mat &gray, const CircleOutline &outside, const CircleOutline &center,
+                  const QVector<std::vector<cv::Point> > &polygons, const igramPipelineParams &p,
+                  igramCrop &crop);
+cv::Mat_<double> subtractPlane(cv::Mat_<double> phase, cv::Mat_<bool> mask);
+// Unwraps the vortex phase into the surface in waves.  The outlines in crop are flipped to match
+// the surface.
+cv::Mat unwrapIgramPhase(const cv::Mat &phase, igramCrop &crop, const igramPipelineParams &p);
+
+#endif // IGRAMPIPELINE_H
@@ -48,6 +48,8 @@
 #include "colorchannel.h"
 #include "opencv2/opencv.hpp"
 #include "spdlog/spdlog.h"
+#include "wavefrontcatalogdlg.h"
+#include "igramfolderwatcher.h"
 
 
 using namespace QtConcurrent;
@@ -59,7 +61,8 @@ MainWindow *MainWindow::me = 0;
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),m_showChannels(false), m_showIntensity(false),m_inBatch(false),m_OutlineDoneInBatch(false),
-    m_batchMakeSurfaceReady(false), m_astigStatsDlg(0), m_cameraCalibWizard(nullptr)
+    m_batchMakeSurfaceReady(false), m_batchRunning(false), m_igramWatcher(0), m_watchProcessed(0), m_watchDropped(0),
+    m_astigStatsDlg(0), m_cameraCalibWizard(nullptr)
 {
     ui->setupUi(this);
     ui->useAnnulust->hide();
@@ -175,6 +178,11 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(m_contourView, SIGNAL(showAllContours()), m_surfaceManager, SLOT(showAllContours()));
     connect(m_dftArea, SIGNAL(newWavefront(cv::Mat,CircleOutline,CircleOutline,QString, QVector<std::vector<cv::Point> >)),
             m_surfaceManager, SLOT(createSurfaceFromPhaseMap(cv::Mat,CircleOutline,CircleOutline,QString, QVector<std::vector<cv::Point> >)));
+    connect(m_dftArea, SIGNAL(newPreview(int,cv::Mat,CircleOutline,CircleOutline,QString, QVector<std::vector<cv::Point> >)),
+            m_surfaceManager, SLOT(createPreviewFromPhaseMap(int,cv::Mat,CircleOutline,CircleOutline,QString, QVector<std::vector<cv::Point> >)));
+    connect(m_dftArea, SIGNAL(previewDone(int,cv::Mat,CircleOutline,CircleOutline,QString, QVector<std::vector<cv::Point> >)),
+            m_surfaceManager, SLOT(replacePreviewFromPhaseMap(int,cv::Mat,CircleOutline,CircleOutline,QString, QVector<std::vector<cv::Point> >)));
+    connect(m_dftArea, SIGNAL(discardPreview(int)), m_surfaceManager, SLOT(discardPreview(int)));
     connect(m_surfaceManager, SIGNAL(diameterChanged(double)),this,SLOT(diameterChanged(double)));
     connect(m_surfaceManager, SIGNAL(showTab(int)), ui->tabWidget, SLOT(setCurrentIndex(int)));
     connect(m_surfTools, SIGNAL(updateSelected()), m_surfaceManager, SLOT(backGroundUpdate()));
@@ -262,37 +270,17 @@ MainWindow::MainWindow(QWidget *parent) :
 }
 int showmem(QString t);
 void MainWindow::openWaveFrontonInit(QStringList args){
-    QProgressDialog pd("    Loading wavefronts in progress.", "Cancel", 0, 100);
-    pd.setRange(0, args.size());
-    if (args.length()> 0)
-        pd.show();
     m_surfaceManager->initWaveFrontLoad();
-    int cnt = 0;
-
+    QStringList files;
     foreach( QString arg, args){
-        //int mem = showmem("loading");
-
-//        if (mem< memThreshold){
-//            int resp = QMessageBox::warning(0,"low on memory", "Do you want to continue?", QMessageBox::Yes|QMessageBox::No);
-//            if (resp == QMessageBox::No)
-//               break;
-//        }
-        qApp->processEvents();
-        if (pd.wasCanceled())
-            break;
-
-        if (arg.endsWith(".wft", Qt::CaseInsensitive)){
-            pd.setLabelText(arg);
-            try {
-            m_surfaceManager->loadWavefront(arg);
-            }
-            catch (int i){
-                break;
-            }
-            pd.setValue(++cnt);
-
+        if (arg.endsWith(".wft", Qt::CaseInsensitive) || arg.endsWith(".wftb", Qt::CaseInsensitive)){
+            files << arg;
         }
     }
+    if (files.size() > 0){
+        waveFrontLoader loader;
+        loader.loadx(files, m_surfaceManager);
+    }
 
     ui->tabWidget->setCurrentIndex(2);
 
@@ -609,9 +597,9 @@ QStringList MainWindow::SelectWaveFrontFiles(){
     QSettings settings;
     QString lastPath = settings.value("lastPath",".").toString();
 
-    QFileDialog dialog(this, "load wave front file", lastPath, tr("wft(*.wft)"));
+    QFileDialog dialog(this, "load wave front file", lastPath, tr("wft(*.wft *.wftb)"));
     dialog.setFileMode(QFileDialog::ExistingFiles);
-    dialog.setNameFilter(tr("wft (*.wft)"));
+    dialog.setNameFilter(tr("wft (*.wft *.wftb)"));
 
     if (dialog.exec()) {
         QStringList fileNames = dialog.selectedFiles();
@@ -711,6 +699,43 @@ void MainWindow::on_actionSave_Wavefront_triggered()
 {
     m_surfaceManager->SaveWavefronts(false);
 }
+
+void MainWindow::on_actionSave_session_triggered()
+{
+    QSettings settings;
+    QString lastPath = settings.value("lastPath","").toString();
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Save session"), lastPath,
+                                                    tr("DFTFringe session (*.dfts)"));
+    if (fileName.isEmpty())
+        return;
+    if (QFileInfo(fileName).suffix().isEmpty()) { fileName.append(".dfts"); }
+    settings.setValue("lastPath", QFileInfo(fileName).absolutePath());
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool ok = m_surfaceManager->saveSession(fileName);
+    QApplication::restoreOverrideCursor();
+    if (!ok)
+        QMessageBox::warning(this, tr("Save session"), tr("Cannot write file %1").arg(fileName));
+}
+
+void MainWindow::on_actionRestore_session_triggered()
+{
+    QSettings settings;
+    QString lastPath = settings.value("lastPath","").toString();
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Restore session"), lastPath,
+                                                    tr("DFTFringe session (*.dfts)"));
+    if (fileName.isEmpty())
+        return;
+    settings.setValue("lastPath", QFileInfo(fileName).absolutePath());
+    m_surfaceManager->restoreSession(fileName);
+    ui->tabWidget->setCurrentIndex(2);
+}
+void MainWindow::on_actionWavefront_catalog_triggered()
+{
+    wavefrontCatalogDlg dlg(m_surfaceManager, this);
+    dlg.exec();
+    if (m_surfaceManager->m_wavefronts.size() > 0)
+        ui->tabWidget->setCurrentIndex(2);
+}
 void MainWindow::showMessage(QString msg, int id){
 
     switch(id){
@@ -1018,20 +1043,82 @@ void MainWindow::batchMakeSurfaceReady(){
     m_batchMakeSurfaceReady = true;
 }
 void MainWindow::batchFinished(int ){
+    if (m_igramWatcher)
+        m_igramWatcher->stop();
     batchConnections(false);
 }
 
+void MainWindow::updateWatchStatus(){
+    if (!m_igramWatcher || !m_igramWatcher->isWatching()){
+        batchIgramWizard::watchStatus->clear();
+        return;
+    }
+    QString txt = tr("Watching %1: %2 processed, %3 waiting").arg(m_igramWatcher->directory())
+            .arg(m_watchProcessed).arg(m_igramWatcher->pending());
+    if (m_watchDropped > 0)
+        txt += tr(", %1 skipped because the queue was full").arg(m_watchDropped);
+    batchIgramWizard::watchStatus->setText(txt);
+}
+
+void MainWindow::batchWatchFolder(QString dir){
+    if (!m_igramWatcher){
+        m_igramWatcher = new igramFolderWatcher(this);
+        connect(m_igramWatcher, SIGNAL(igramReady()), this, SLOT(processWatchedIgrams()), Qt::QueuedConnection);
+        connect(m_igramWatcher, SIGNAL(dropped(QString)), this, SLOT(watchedIgramDropped(QString)));
+    }
+    if (dir.isEmpty()){
+        m_igramWatcher->stop();
+        updateWatchStatus();
+        return;
+    }
+    if (!m_igramWatcher->start(dir)){
+        QMessageBox::warning(this, tr("Watch Folder"), tr("Cannot watch folder %1").arg(dir));
+        batchIgramWizard::watchFolder->setChecked(false);
+        return;
+    }
+    // nobody is at the computer to adjust the outline so use the last one.
+    batchIgramWizard::autoCb->setChecked(true);
+    m_watchProcessed = 0;
+    m_watchDropped = 0;
+    updateWatchStatus();
+}
+
+// Runs the images that finished arriving through the normal batch steps.  Images that arrive
+// while a batch is running are picked up when it ends.
+void MainWindow::processWatchedIgrams(){
+    if (!m_igramWatcher || !m_igramWatcher->isWatching() || m_batchRunning)
+        return;
+    QStringList files;
+    QString fn;
+    while (!(fn = m_igramWatcher->takeNext()).isEmpty())
+        files << fn;
+    if (files.isEmpty())
+        return;
+    batchWiz->introPage->filesList->addItems(files);
+    if (!m_inBatch)
+        batchConnections(true);
+    batchProcess(files);
+    m_watchProcessed += files.size();
+    updateWatchStatus();
+}
+
+void MainWindow::watchedIgramDropped(QString fileName){
+    ++m_watchDropped;
+    qDebug() << "watch folder skipped" << fileName;
+    updateWatchStatus();
+}
+
 void MainWindow::batchConnections(bool flag){
     qDebug() << "BatchConnection " << flag;
     if (flag){
         m_inBatch = true;
-        disconnect(m_dftTools, SIGNAL(makeSurface()), m_dftArea, SIGNAL(makeSurface()));
+        disconnect(m_dftTools, SIGNAL(makeSurface()), m_dftArea, SLOT(makeSurfaceInBackground()));
         connect(m_dftTools, SIGNAL(makeSurface()), this, SLOT(batchMakeSurfaceReady()));
         connect(batchIgramWizard::saveZerns, SIGNAL(pressed()), this, SLOT(saveBatchZerns()));
     }
     else {
         m_inBatch = false;
-        connect(m_dftTools, SIGNAL(makeSurface()), m_dftArea, SLOT(makeSurface()));
+        connect(m_dftTools, SIGNAL(makeSurface()), m_dftArea, SLOT(makeSurfaceInBackground()), Qt::UniqueConnection);
         disconnect(m_dftTools, SIGNAL(makeSurface()), this, SLOT(batchMakeSurfaceReady()));
         disconnect(batchIgramWizard::saveZerns, SIGNAL(pressed()), this, SLOT(saveBatchZerns()));
     }
@@ -1065,7 +1152,12 @@ void MainWindow::saveBatchZerns(){
 }
 
 
+// Each frame is outlined, made and reviewed before the next one is loaded, so there is never a stack
+// to hand to vortexPhaseBatch.  Same size frames still share the cached vortex frequency tables.
 void MainWindow::batchProcess(QStringList fileList){
+    if (fileList.isEmpty())
+        return;
+    m_batchRunning = true;
     m_contourView->getPlot()->blockSignals(true);
     QSettings settings;
     bool shouldBeep = settings.value("RMSBeep>", true).toBool();
@@ -1075,14 +1167,15 @@ void MainWindow::batchProcess(QStringList fileList){
     batchIgramWizard::skipFile->setEnabled(true);
     m_skipItem = false;
     QApplication::processEvents();
-    QFileInfo info(m_igramsToProcess[0]);
+    QFileInfo info(fileList[0]);
     batchWiz->showPlots(batchIgramWizard::showProcessPlots->isChecked());
     QString lastPath = info.absolutePath();
     settings.setValue("lastPath",lastPath);
     int memThreshold = settings.value("lowMemoryThreshold", 300).toInt();
     int last = fileList.size()-1;
 
-    int ndx = 0;
+    // watched folder images are appended to the files list
+    int ndx = qMax(0, batchWiz->introPage->filesList->count() - fileList.size());
     int cnt = 0;
     int width, height;
     foreach(QString fn, fileList){
@@ -1254,8 +1347,10 @@ void MainWindow::batchProcess(QStringList fileList){
         QToolTip::showText( batchIgramWizard::saveZerns->mapToGlobal(QPoint(0,20)),batchIgramWizard::saveZerns->toolTip());
 
     }
-    connect(batchWiz->introPage->astigPlot, SIGNAL(waveSeleted(QString)), m_surfaceManager, SLOT(wavefrontDClicked(QString)));
-    connect(batchWiz->introPage->m_rmsPlot, SIGNAL(waveSeleted(QString)), m_surfaceManager, SLOT(wavefrontDClicked(QString)));
+    connect(batchWiz->introPage->astigPlot, SIGNAL(waveSeleted(QString)), m_surfaceManager, SLOT(wavefrontDClicked(QString)),
+            Qt::UniqueConnection);
+    connect(batchWiz->introPage->m_rmsPlot, SIGNAL(waveSeleted(QString)), m_surfaceManager, SLOT(wavefrontDClicked(QString)),
+            Qt::UniqueConnection);
     progBar->reset();
     batchIgramWizard::goPb->setEnabled(true);
     batchIgramWizard::addFiles->setEnabled(true);
@@ -1263,6 +1358,9 @@ void MainWindow::batchProcess(QStringList fileList){
 
     this->setCursor(Qt::ArrowCursor);
     m_contourView->getPlot()->blockSignals(false);
+    m_batchRunning = false;
+    if (m_igramWatcher && m_igramWatcher->pending() > 0)
+        QTimer::singleShot(0, this, SLOT(processWatchedIgrams()));
 
 }
 
@@ -1731,7 +1829,6 @@ void MainWindow::on_actionDebugStuff_triggered()
 
 }
 
-
 #include "outlinestatsdlg.h"
 void MainWindow::on_actionShow_outline_statistics_triggered()
 {
@@ -1829,6 +1926,7 @@ void MainWindow::on_actionSmooth_current_wave_front_triggered()
         QMessageBox::warning(this, "No Wavefronts", "You must first load a wave front");
         return;
     }
+    wavefrontResidency::get_Instance()->touch(sm.m_wavefronts[sm.m_currentNdx]);
     ZernikeSmoothingDlg *dlg = new ZernikeSmoothingDlg(*sm.m_wavefronts[sm.m_currentNdx]);
     dlg->resize(1000,1000);
     dlg->show();
@@ -50,6 +50,7 @@
 #include "cameracalibwizard.h"
 
 class regionEditTools;
+class igramFolderWatcher;
 namespace Ui {
 class MainWindow;
 }
@@ -99,6 +100,9 @@ public slots:
     void zoomProfile(bool flag);
     void imageSize(QString txt);
     void skipBatchItem();
+    void batchWatchFolder(QString dir);
+    void processWatchedIgrams();
+    void watchedIgramDropped(QString fileName);
     int  getCurrentTab();
     void setTab(int ndx);
 signals:
@@ -139,6 +143,9 @@ private slots:
     void on_actionWrite_WaveFront_triggered();
 
     void on_actionSave_Wavefront_triggered();
+    void on_actionSave_session_triggered();
+    void on_actionRestore_session_triggered();
+    void on_actionWavefront_catalog_triggered();
 
     void on_SelectOutSideOutline_clicked(bool checked);
 
@@ -320,6 +327,11 @@ private:
     bool m_skipItem;
     bool m_OutlineDoneInBatch;
     bool m_batchMakeSurfaceReady;
+    bool m_batchRunning;
+    igramFolderWatcher *m_igramWatcher;
+    int m_watchProcessed;
+    int m_watchDropped;
+    void updateWatchStatus();
     astigStatsDlg *m_astigStatsDlg;
 
     enum { MaxRecentFiles = 5 };
@@ -143,7 +143,7 @@ double mirrorDlg::getMinorAxis(){
 bool mirrorDlg::isEllipse(){
     return m_outlineShape == ELLIPSE;
 }
-void mirrorDlg::saveJson(QString fileName){
+QJsonObject mirrorDlg::configJson(){
     QJsonObject jDoc, jMirror,jIgram, jEllipse, jAnnulus;
     jDoc["name"] = m_name;
     jDoc["show units in mm"] = mm;
@@ -169,7 +169,11 @@ void mirrorDlg::saveJson(QString fileName){
     jDoc["igram"] = jIgram;
     jDoc["ellipse"] = jEllipse;
     jDoc["Annulus"] = jAnnulus;
-    QJsonDocument jsondoc = QJsonDocument(jDoc);
+    return jDoc;
+}
+
+void mirrorDlg::saveJson(QString fileName){
+    QJsonDocument jsondoc = QJsonDocument(configJson());
 
     QFile saveFile(fileName);
 
@@ -273,68 +277,7 @@ void mirrorDlg::loadFile(QString & fileName){
         }
 
         QByteArray saveData = loadFile.readAll();
-        QJsonDocument loadDoc(QJsonDocument::fromJson(saveData));
-
-        ui->name->setText(QJsonValue(loadDoc["name"]).toString());
-        ui->unitsCB->setChecked(true);
-        mm=true;  // setChecked() does not call on_unitsCB_clicked()
-
-        // set diameter early - before setting roc and annulus percentage
-        QJsonObject mirror = loadDoc["mirror"].toObject();
-        diameter = QJsonValue(mirror["diameter"]).toDouble();
-        ui->diameter->blockSignals(true);
-        ui->diameter->setText(QString("%1").arg(diameter, 6, 'f', 2));
-        ui->diameter->blockSignals(false);
-
-        ui->nullCB->setChecked( QJsonValue(loadDoc["useNull"]).toBool());
-
-        obs = QJsonValue(mirror["obs diameter"]).toDouble();
-        roc = QJsonValue(mirror["roc"]).toDouble();
-        cc = QJsonValue(mirror["desired conic"]).toDouble();
-        m_aperatureReductionEnabled = QJsonValue(mirror["edgeMaskon"]).toBool();
-        aperatureReduction=QJsonValue( mirror["edge mask value"]).toDouble();
-
-        QJsonObject Igram = loadDoc["igram"].toObject();
-        lambda = QJsonValue(Igram["wavelength"]).toDouble();
-        z8 = QJsonValue(Igram["null value"]).toDouble();
-        fliph = QJsonValue(Igram["flip horizontal"]).toBool();
-        flipv = QJsonValue(Igram["flip vert"]).toBool();
-        fringeSpacing = QJsonValue(Igram["fringe spacing"]).toDouble();
-        QJsonObject Ellipse = loadDoc["Ellispe"].toObject();
-        m_outlineShape = (outlineShape)QJsonValue(Ellipse["is ellipse"]).toInt();
-        m_verticalAxis = QJsonValue(Ellipse["ellipse vert axis"]).toDouble();
-        QJsonObject Annulus = loadDoc["Annulus"].toObject();
-        m_useAnnular = QJsonValue(Annulus["use annular Zernike values"]).toBool();
-        m_annularObsPercent = QJsonValue(Annulus["obs percentage"]).toDouble();
-        ui->useAnnulus->setChecked(m_useAnnular);
-        ui->annulusPercent->setValue(m_annularObsPercent * 100);
-        on_annulusPercent_valueChanged(m_annularObsPercent * 100);
-        enableAnnular(m_useAnnular);
-
-        ui->fringeSpacingEdit->blockSignals(true);
-        ui->fringeSpacingEdit->setText(QString("%1").arg(fringeSpacing, 3, 'f', 1));
-        ui->fringeSpacingEdit->blockSignals(false);
-
-        ui->obs->setText(QString().number(obs));
-
-
-        ui->roc->blockSignals(true);
-        ui->roc->setText(QString("%1").arg(roc, 6, 'f', 2));
-        ui->roc->blockSignals(false);
-
-        ui->cc->setText(QString().number(cc));
-
-        ui->z8->setText(QString().number(z8));
-
-        ui->ellipseShape->setChecked(m_outlineShape == ELLIPSE);
-
-        ui->minorAxisEdit->setText(QString::number(m_verticalAxis));
-
-        FNumber = roc/(2. * diameter);
-        ui->FNumber->blockSignals(true);
-        ui->FNumber->setText(QString("%1").arg(FNumber, 6, 'f', 2));
-        ui->FNumber->blockSignals(false);
-
+        setConfigJson(QJsonDocument::fromJson(saveData).object());
         blockSignals(false);
     }
     else {
@@ -479,6 +422,71 @@ void mirrorDlg::loadFile(QString & fileName){
         }
     }
 }
+
+// set the config from the json object written by configJson().
+void mirrorDlg::setConfigJson(const QJsonObject &loadDoc){
+    ui->name->setText(QJsonValue(loadDoc["name"]).toString());
+    ui->unitsCB->setChecked(true);
+    mm=true;  // setChecked() does not call on_unitsCB_clicked()
+
+    // set diameter early - before setting roc and annulus percentage
+    QJsonObject mirror = loadDoc["mirror"].toObject();
+    diameter = QJsonValue(mirror["diameter"]).toDouble();
+    ui->diameter->blockSignals(true);
+    ui->diameter->setText(QString("%1").arg(diameter, 6, 'f', 2));
+    ui->diameter->blockSignals(false);
+
+    ui->nullCB->setChecked( QJsonValue(loadDoc["useNull"]).toBool());
+
+    obs = QJsonValue(mirror["obs diameter"]).toDouble();
+    roc = QJsonValue(mirror["roc"]).toDouble();
+    cc = QJsonValue(mirror["desired conic"]).toDouble();
+    m_aperatureReductionEnabled = QJsonValue(mirror["edgeMaskon"]).toBool();
+    aperatureReduction=QJsonValue( mirror["edge mask value"]).toDouble();
+
+    QJsonObject Igram = loadDoc["igram"].toObject();
+    lambda = QJsonValue(Igram["wavelength"]).toDouble();
+    z8 = QJsonValue(Igram["null value"]).toDouble();
+    fliph = QJsonValue(Igram["flip horizontal"]).toBool();
+    flipv = QJsonValue(Igram["flip vert"]).toBool();
+    fringeSpacing = QJsonValue(Igram["fringe spacing"]).toDouble();
+    // older versions saved "ellipse" but read "Ellispe"
+    QJsonObject Ellipse = loadDoc[loadDoc.contains("ellipse") ? "ellipse" : "Ellispe"].toObject();
+    m_outlineShape = (outlineShape)QJsonValue(Ellipse["is ellipse"]).toInt();
+    m_verticalAxis = QJsonValue(Ellipse["ellipse vert axis"]).toDouble();
+    QJsonObject Annulus = loadDoc["Annulus"].toObject();
+    m_useAnnular = QJsonValue(Annulus["use annular Zernike values"]).toBool();
+    m_annularObsPercent = QJsonValue(Annulus["obs percentage"]).toDouble();
+    ui->useAnnulus->setChecked(m_useAnnular);
+    ui->annulusPercent->setValue(m_annularObsPercent * 100);
+    on_annulusPercent_valueChanged(m_annularObsPercent * 100);
+    enableAnnular(m_useAnnular);
+
+    ui->fringeSpacingEdit->blockSignals(true);
+    ui->fringeSpacingEdit->setText(QString("%1").arg(fringeSpacing, 3, 'f', 1));
+    ui->fringeSpacingEdit->blockSignals(false);
+
+    ui->obs->setText(QString().number(obs));
+
+
+    ui->roc->blockSignals(true);
+    ui->roc->setText(QString("%1").arg(roc, 6, 'f', 2));
+    ui->roc->blockSignals(false);
+
+    ui->cc->setText(QString().number(cc));
+
+    ui->z8->setText(QString().number(z8));
+
+    ui->ellipseShape->setChecked(m_outlineShape == ELLIPSE);
+
+    ui->minorAxisEdit->setText(QString::number(m_verticalAxis));
+
+    FNumber = roc/(2. * diameter);
+    ui->FNumber->blockSignals(true);
+    ui->FNumber->setText(QString("%1").arg(FNumber, 6, 'f', 2));
+    ui->FNumber->blockSignals(false);
+}
+
 void mirrorDlg::on_ReadBtn_clicked()
 {
     QSettings settings;
@@ -20,6 +20,7 @@
 
 #include <QDialog>
 #include <QTimer>
+#include <QJsonObject>
 
 namespace Ui {
 class mirrorDlg;
@@ -36,6 +37,8 @@ public:
     mirrorDlg& operator=(const mirrorDlg&) = delete;
 
     void loadFile(QString & fileName);
+    QJsonObject configJson();
+    void setConfigJson(const QJsonObject &obj);
     void updateZ8();
 
     QString m_name;
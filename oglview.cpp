@@ -32,6 +32,7 @@
 #include <QtDataVisualization/QHeightMapSurfaceDataProxy>
 #include <QtDataVisualization/QSurface3DSeries>
 #include "surfacegraph.h"
+#include "wavefrontresidency.h"
 #include <QMessageBox>
 #include <QGroupBox>
 #include <QFileDialog>
@@ -193,6 +194,7 @@ void OGLView::showSelected()    // show all selected wavefronts as 3D plots
     for (int i = 0; i < list.size(); ++i)
     {
         wavefront * wf = m_wavefronts[list[i]];
+        wavefrontResidency::get_Instance()->touch(wf);
         m_surface->setSurface(wf);
         QImage glImage = m_surface->render(width,width);
         QPainter p2(&glImage);
@@ -204,6 +206,9 @@ void OGLView::showSelected()    // show all selected wavefronts as 3D plots
         int x_offset = width * (i%columns) + 20;
         painter.drawImage(x_offset,y_offset, glImage.scaled(width, height,Qt::KeepAspectRatio));
     }
+    // put the current wave front back in the 3D view so it does not hold one that may be spilled
+    if (SurfaceManager::get_instance()->getCurrent())
+        m_surface->setSurface(SurfaceManager::get_instance()->getCurrent());
 
     //image.save( "tmp.png" );
     QWidget *w = new QWidget;
@@ -17,6 +17,7 @@
 ****************************************************************************/
 #include "profileplot.h"
 #include "ui_profileplot.h"
+#include "wavefrontresidency.h"
 #include <QtWidgets>
 #include <qwt_compass.h>
 #include <qwt_compass_rose.h>
@@ -567,6 +568,7 @@ void ProfilePlot::populate()
 
             cprofile->setPen(QPen(Settings2::m_profile->getColor(i),width));
             cprofile->setRenderHint( QwtPlotItem::RenderAntialiased );
+            wavefrontResidency::get_Instance()->touch(wfs->at(list[i]));
             cprofile->setSamples( createProfile( m_showNm * m_showSurface,wfs->at(list[i])));
             cprofile->attach( m_plot );
 
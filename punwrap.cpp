@@ -19,31 +19,10 @@
 #include "punwrap.h"
 #include <math.h>
 #include <algorithm>
-#include <queue>
 #include <cstring>
-int xsize,ysize;
-double* qmap = NULL;
-double* phase;
-double* unwrapped;
-
-#include <stdlib.h>
-#include <math.h>
+#include <QThreadStorage>
 
 #define WRAP(x) (((x) > 0.5) ? ((x)-1.0) : (((x) <= -0.5) ? ((x)+1.0) : (x)))
-//double WRAP(double x){
-//   if (x > .5){
-//       return x - 1.;
-//   }
-//   else if (x <= -.5){
-//       return x+1.0;
-
-//   }
-//   return x;
-//}
-
-char* flags = NULL;
-#define BORDER      0x1
-#define UNWRAPPED   0x2
 
 #define SWAP(a, i, j)                           \
     {                                           \
@@ -53,7 +32,7 @@ char* flags = NULL;
     }
 
 static
-void todo_push (int ndx, double *qmap, int *todo, int *end)
+void todo_push (int ndx, const double *qmap, int *todo, int *end)
 {
     int child;
     todo[*end] = ndx;
@@ -70,7 +49,7 @@ void todo_push (int ndx, double *qmap, int *todo, int *end)
 }
 
 static
-int todo_pop(double *qmap, int *todo, int *end)
+int todo_pop(const double *qmap, int *todo, int *end)
 {
     int result = todo[0], root;
     --(*end);
@@ -90,44 +69,122 @@ int todo_pop(double *qmap, int *todo, int *end)
     return (result);
 }
 
+// todo_push and todo_pop with the interface of qualityBucketQueue
+class todoHeap {
+public:
+    todoHeap(const double *qmap, int *todo): m_qmap(qmap), m_todo(todo), m_end(0){}
+    void push(int ndx){ todo_push(ndx, m_qmap, m_todo, &m_end); }
+    int pop(){ return todo_pop(m_qmap, m_todo, &m_end); }
+    bool empty() const { return m_end == 0; }
+private:
+    const double *m_qmap;
+    int *m_todo;
+    int m_end;
+};
+
+void qualityBucketQueue::reset(const double *qmap, const char *skip, int size, int buckets){
+    m_qmap = qmap;
+    double lo = HUGE_VAL;
+    double hi = -HUGE_VAL;
+    for (int k = 0; k < size; ++k){
+        if (!skip[k]){
+            lo = std::min(lo, qmap[k]);
+            hi = std::max(hi, qmap[k]);
+        }
+    }
+    m_min = lo;
+    m_last = buckets - 1;
+    m_scale = (hi > lo) ? m_last / (hi - lo) : 0.;
+    m_top = 0;
+    m_count = 0;
+    m_head.assign(buckets, -1);
+    m_tail.assign(buckets, -1);
+    if ((int)m_next.size() < size)
+        m_next.resize(size);
+}
+
+size_t qualityBucketQueue::bytes() const{
+    return (m_head.size() + m_tail.size() + m_next.size()) * sizeof(int);
+}
+
+// region seeds best quality first, the first pixel of equal ones like the old search found them
+class seedOrder {
+public:
+    seedOrder(const double *qmap): m_qmap(qmap){}
+    bool operator() (int a, int b) const {
+        return m_qmap[a] > m_qmap[b] || (m_qmap[a] == m_qmap[b] && a < b);
+    }
+private:
+    const double *m_qmap;
+};
+
+void regionSeeds(int nx, int ny, const double *qmap, char *flags, int *stack, std::vector<int> &seeds)
+{
+    const char visited = 0x4;
+    const int size = nx * ny;
+    seeds.clear();
+    seedOrder better(qmap);
+    for (int k = 0; k < size; ++k){
+        if (flags[k])
+            continue;
+        // flood fill the region keeping its best pixel
+        int best = k;
+        int top = 0;
+        flags[k] |= visited;
+        stack[top++] = k;
+        while (top){
+            int ndx = stack[--top];
+            if (better(ndx, best))
+                best = ndx;
+            int x = ndx%nx;
+            int y = ndx/nx;
+            if (x > 0 && ! flags[ndx-1]){
+                flags[ndx-1] |= visited;
+                stack[top++] = ndx-1;
+            }
+            if (x < nx-1 && ! flags[ndx+1]){
+                flags[ndx+1] |= visited;
+                stack[top++] = ndx+1;
+            }
+            if (y > 0 && ! flags[ndx-nx]){
+                flags[ndx-nx] |= visited;
+                stack[top++] = ndx-nx;
+            }
+            if (y < ny-1 && ! flags[ndx+nx]){
+                flags[ndx+nx] |= visited;
+                stack[top++] = ndx+nx;
+            }
+        }
+        seeds.push_back(best);
+    }
+    for (int k = 0; k < size; ++k)
+        flags[k] &= ~visited;
+    std::sort(seeds.begin(), seeds.end(), better);
+}
+
 #define unwrap_and_insert(ndx, val)             \
     {                                           \
         unwrapped[ndx] = val;                   \
         flags[ndx] |= UNWRAPPED;                \
-        path[ndx] = order++;                    \
-        todo_push (ndx, qmap, todo, &end);      \
+        todo.push (ndx);                        \
     }
 
 // Quality-guided path following phase unwrapper.
-void qg_path_follower (int nx, int ny, double *phase, double *qmap,
-                       double *unwrapped, double *path)
+template <typename Queue>
+void phaseUnwrapper::pathFollower(int nx, int ny, const double *phase, double *unwrapped, Queue &todo)
 {
-    int *todo;
-    int end;
-    int order = 0;
-    int size = nx * ny;
-
-    // Initialize the to do list.
-    todo = (int*)calloc (size, sizeof (int));
-    end = 0;
-
-    // Repeat while still elements to unwrap (handles disjoint regions).
-    while (1) {
-
-        // Find the point of highest quality.
-        double m = -HUGE_VAL;
-        int mndx = 0;
-        for (int k=0; k < size; ++k)
-            if (qmap[k] > m && ! flags[k])
-                m = qmap[mndx = k];
-        if (m == -HUGE_VAL) break;
+    char *flags = &m_flags[0];
+
+    // One pass for each disjoint region.
+    for (size_t s = 0; s < m_seeds.size(); ++s) {
+        int mndx = m_seeds[s];
 
         // Unwrap the first point.
         unwrap_and_insert (mndx, phase[mndx]);
 
         // Unwrap the rest of the points in order of quality.
-        while (end) {
-            int ndx = todo_pop (qmap, todo, &end);
+        while (!todo.empty()) {
+            int ndx = todo.pop();
             int x = ndx%nx;
             int y = ndx/nx;
             double val = unwrapped[ndx];
@@ -145,274 +202,340 @@ void qg_path_follower (int nx, int ny, double *phase, double *qmap,
                 unwrap_and_insert (ndx+nx, val+WRAP(phase[ndx+nx]-phase[ndx]));
         }
     }
-
-
-    free (todo);
 }
 
-
-void dv_quality_map (double *pphase,int width, double *qmap, int nx, int ny)
+// Sums of the K values of each pixel over a width x width window clipped at the edges.  load(y, values)
+// fills the K values of each pixel of row y one after the other and store(y, sums) gets the window sums
+// of row y the same way.  The rows are split into strips on the opencv thread pool.  Each strip keeps
+// the running horizontal sums of the last width rows and a running vertical sum of those.
+template <int K, typename Load, typename Store>
+static void windowSums(int nx, int ny, int width, const Load &load, const Store &store)
 {
-  double *dx;
-  double *dy;
-
-  dx = (double*)calloc (nx*ny, sizeof (double));
-  dy = (double*)calloc (nx*ny, sizeof (double));
-
-  // Calculate the arrays of gradients.
-  for (int x=0; x < nx; ++x)
-    for (int y=0; y < ny; ++y) {
-      int ndx = y*nx+x;
-      if (x == nx-1)
-        dx[ndx] = 0.0;
-      else
-        dx[ndx] = WRAP (pphase[ndx+1] - pphase[ndx]);
-      if (y == ny-1)
-        dy[ndx] = 0.0;
-      else
-        dy[ndx] = WRAP (pphase[ndx+nx] - pphase[ndx]);
-    }
-
-  // Calculate the variance of the gradients over the moving window.
-  int start = -(width/2);
-  int end = start+width;
-  int size = width * width;
-  double* ex = new double[size];
-  double* ey = new double[size];
-
-  for ( int x=0; x < nx; ++x)
-    for (int y=0; y < ny; ++y) {
-      int n = 0;
-      // Load elements from window into ex and ey.
-      for (int i = std::max(x+start, 0); i < std::min(x+end, nx-1); ++i)
-            for (int j = std::max(y+start, 0); j < std::min(y+end, ny-1); ++j) {
-                int ndx = j*nx + i;
-                if (0.0 != (dx[ndx]) && 0.0 != (dy[ndx])) {
-                    ex[n] = dx[ndx];
-                    ey[n] = dy[ndx];
-                    n++;
+    const int start = -(width/2);
+    const int end = start + width;
+    cv::parallel_for_(cv::Range(0, ny), [&](const cv::Range &strip){
+        std::vector<double> values(nx * K);
+        std::vector<double> rows(width * nx * K);     // horizontal sums, row r in slot r % width
+        std::vector<double> column(nx * K, 0.);
+        // horizontal sums of row r into its slot and adds them to the vertical sums
+        auto addRow = [&](int r){
+            load(r, &values[0]);
+            double *h = &rows[(r % width) * nx * K];
+            double s[K] = {0};
+            for (int i = 0; i < std::min(end, nx); ++i)
+                for (int k = 0; k < K; ++k)
+                    s[k] += values[i*K + k];
+            for (int x = 0; x < nx; ++x){
+                for (int k = 0; k < K; ++k){
+                    h[x*K + k] = s[k];
+                    column[x*K + k] += s[k];
                 }
+                if (x + end < nx)
+                    for (int k = 0; k < K; ++k)
+                        s[k] += values[(x + end)*K + k];
+                if (x + start >= 0)
+                    for (int k = 0; k < K; ++k)
+                        s[k] -= values[(x + start)*K + k];
             }
-      int ndx = y*nx + x;
-      if (n < 1)
-        qmap[ndx] = 0;
-      else {
-        double mx = 0, my = 0;
-        for (int k=0; k < n; k++) {
-            mx += ex[k];
-            my += ey[k];
-        }
-        mx /= n;
-        my /= n;
-        double sx = 0;
-        double sy = 0;
-        for (int k=0; k < n; k++) {
-            sx += pow (ex[k]-mx, 2);
-            sy += pow (ey[k]-my, 2);
+        };
+        auto removeRow = [&](int r){
+            const double *h = &rows[(r % width) * nx * K];
+            for (int i = 0; i < nx * K; ++i)
+                column[i] -= h[i];
+        };
+
+        for (int r = std::max(strip.start + start, 0); r < std::min(strip.start + end - 1, ny); ++r)
+            addRow(r);
+        for (int y = strip.start; y < strip.end; ++y){
+            if (y + end - 1 < ny)
+                addRow(y + end - 1);
+            store(y, &column[0]);
+            if (y + start >= 0)
+                removeRow(y + start);
         }
-        qmap[ndx] = (sqrt(sx) + sqrt(sy)) / (size);
-      }
-    }
-
-  free (dx);
-  free (dy);
-  delete[] ex;
-  delete[] ey;
-
+    }, std::max(1., ny / 64.));
 }
 
+// Variance of the phase gradients over a width x width window.  Lower is better so it is stored
+// negated for the path follower.  Only pixels where both gradients are non zero count.
+void phaseUnwrapper::dvQualityMap(const double *pphase, int width, int nx, int ny)
+{
+    double *qmap = &m_qmap[0];
+    const double size = width * width;
+    // weight, sums and sums of squares of the gradients of each pixel
+    windowSums<5>(nx, ny, width, [&](int y, double *v){
+        const double *p = pphase + y * nx;
+        for (int x = 0; x < nx; ++x, v += 5){
+            double dx = (x == nx-1) ? 0.0 : WRAP (p[x+1] - p[x]);
+            double dy = (y == ny-1) ? 0.0 : WRAP (p[x+nx] - p[x]);
+            if (dx != 0.0 && dy != 0.0){
+                v[0] = 1.;
+                v[1] = dx;
+                v[2] = dx * dx;
+                v[3] = dy;
+                v[4] = dy * dy;
+            }
+            else
+                v[0] = v[1] = v[2] = v[3] = v[4] = 0.;
+        }
+    },
+    [&](int y, const double *s){
+        double *q = qmap + y * nx;
+        for (int x = 0; x < nx; ++x, s += 5){
+            double n = s[0];
+            if (n < .5)
+                q[x] = 0;
+            else {
+                double sx = std::max(s[2] - s[1] * s[1] / n, 0.);
+                double sy = std::max(s[4] - s[3] * s[3] / n, 0.);
+                q[x] = -(sqrt(sx) + sqrt(sy)) / size;
+            }
+        }
+    });
+}
 
-
+// One minus the pseudo-correlation over a width x width window.  Lower is better.
 void pc_quality_map (int nx, int ny, double *phase, int width, double *qmap)
 {
-  // Calculate the pseudo-correlation over the moving window.
-  int start = -(width/2);
-  int end = start+width;
-  double* ep = new double[width*width];
-
-  for (int x=0; x < nx; ++x)
-    for (int y=0; y < ny; ++y) {
-
-      int n = 0;
-      // Load elements from window into ex and ey.
-      for (int i = std::max(x+start, 0); i < std::min(x+end, nx-1); ++i)
-    for (int j = std::max(y+start, 0); j < std::min(y+end, ny-1); ++j) {
-      int ndx = j*nx + i;
-      if (0.0 != (phase[ndx])) {
-        ep[n] = phase[ndx];
-        n++;
-      }
-    }
-      int ndx = y*nx + x;
-      if (n < 1)
-    qmap[ndx] = 0;
-      else {
-    double sp = 0, cp = 0;
-    for (int k=0; k < n; k++) {
-      sp += sin (ep[k]);
-      cp += cos (ep[k]);
-    }
-    qmap[ndx] = 1 - sqrt(sp*sp + cp*cp) / (width*width);
-      }
-    }
+    const double size = width * width;
+    windowSums<3>(nx, ny, width, [&](int y, double *v){
+        const double *p = phase + y * nx;
+        for (int x = 0; x < nx; ++x, v += 3){
+            if (p[x] != 0.0 && x < nx-1 && y < ny-1){
+                v[0] = 1.;
+                v[1] = sin (p[x]);
+                v[2] = cos (p[x]);
+            }
+            else
+                v[0] = v[1] = v[2] = 0.;
+        }
+    },
+    [&](int y, const double *s){
+        double *q = qmap + y * nx;
+        for (int x = 0; x < nx; ++x, s += 3)
+            q[x] = (s[0] < .5) ? 0 : 1 - sqrt(s[1]*s[1] + s[2]*s[2]) / size;
+    });
 }
 
+// Iteration limit and relative residual of the conjugate gradient least squares.  The limit keeps a
+// masked unwrap to at most 2 * lsIterations dct passes.
+static const int lsIterations = 20;
+static const double lsTolerance = 1e-4;
 
-
-
-
-
-class qual
+// Solves laplacian(result) = rhs with reflecting edges by dividing the dct by the laplacian eigenvalues.
+void phaseUnwrapper::poisson(const cv::Mat &rhs, cv::Mat &result)
 {
-public:
-    int m_ndx;
-    double m_q;
-    qual(int ndx, double qual) : m_ndx(ndx), m_q(qual){};
-};
-
-//Function object to do a less on two points in the quality map
-class comp_qual
-{
-public:
-
-    int operator() (const qual &p1, const qual &p2)
-    {
-    return (p1.m_q < p2.m_q);
+    cv::dct(rhs, result);
+    for (int y = 0; y < result.rows; ++y){
+        double *r = result.ptr<double>(y);
+        for (int x = 0; x < result.cols; ++x)
+            r[x] = (x || y) ? r[x] / (m_cosX[x] + m_cosY[y]) : 0.;
     }
-};
-
-std::priority_queue<qual,std::vector<qual>,comp_qual> To_Do;
-/* input is normalized from 0 to 1 */
-
-#define GRAD(x) (((x) > 0.5) ? ((x)-1.0) : (((x) <= -0.5) ? ((x)+1.0) : (x)))
+    cv::idct(result, result);
+}
 
-/* Insert new pixel into the to do deque. Sorted by quality.  Best at end */
-inline void Insert_To_Do(double val, int index, double q)
+// Laplacian of in using only the differences between neighbouring pixels that both have data.  With
+// wrap the differences are wrapped, which makes the right side of the least squares equations.
+void phaseUnwrapper::weightedLaplacian(const cv::Mat &in, cv::Mat &out, bool wrap)
 {
-  unwrapped[index] = val;
-  To_Do.push(qual(index, q));
-  flags[index] =1;
-  return;
+    const int rows = in.rows;
+    const int cols = in.cols;
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range &range){
+        for (int y = range.start; y < range.end; ++y){
+            const double *p = in.ptr<double>(y);
+            const double *w = m_weight.ptr<double>(y);
+            const double *pn = y > 0 ? in.ptr<double>(y-1) : 0;
+            const double *wn = y > 0 ? m_weight.ptr<double>(y-1) : 0;
+            const double *ps = y < rows-1 ? in.ptr<double>(y+1) : 0;
+            const double *ws = y < rows-1 ? m_weight.ptr<double>(y+1) : 0;
+            double *o = out.ptr<double>(y);
+            for (int x = 0; x < cols; ++x){
+                double s = 0;
+                if (w[x] != 0.){
+                    double c = p[x];
+                    double d[4] = {0, 0, 0, 0};
+                    if (x > 0 && w[x-1] != 0.)
+                        d[0] = p[x-1] - c;
+                    if (x < cols-1 && w[x+1] != 0.)
+                        d[1] = p[x+1] - c;
+                    if (pn && wn[x] != 0.)
+                        d[2] = pn[x] - c;
+                    if (ps && ws[x] != 0.)
+                        d[3] = ps[x] - c;
+                    for (int k = 0; k < 4; ++k)
+                        s += wrap ? WRAP(d[k]) : d[k];
+                }
+                o[x] = s;
+            }
+        }
+    }, std::max(1., rows / 64.));
 }
 
-/* Insert the four neighboring pixels of x,y
-into the to do list.  The quality value for x,y  is val */
-void Add_Neighbors(int mid_ndx, double val)
+// Weighted least squares unwrap of Ghiglia and Romero.  Without masked pixels it is one dct Poisson
+// solve.  Otherwise the masked equations are solved by conjugate gradients with the Poisson solve as
+// the preconditioner.  The result is then made congruent to the wrapped phase.
+void phaseUnwrapper::leastSquares(const double *phase, double *unwrapped, int nx, int ny)
 {
-
-    double  grad;
-    int x = mid_ndx % xsize;
-    int y = mid_ndx / xsize;
-
-    int ndx = mid_ndx -1;
-
-    // left neighbor
-    if ((x-1)>= 0 && !(flags[ndx]))
-    {
-        grad = GRAD(phase[ndx]- phase[mid_ndx]);  // left - middle
-        Insert_To_Do( val + grad, ndx, -fabs(grad));
+    const int rows = ny + (ny & 1);
+    const int cols = nx + (nx & 1);
+    cv::Size size(cols, rows);
+    m_weight.create(size, CV_64F);
+    m_x.create(size, CV_64F);
+    m_r.create(size, CV_64F);
+    m_z.create(size, CV_64F);
+    m_p.create(size, CV_64F);
+    m_ap.create(size, CV_64F);
+    if ((int)m_cosX.size() != cols){
+        m_cosX.resize(cols);
+        for (int k = 0; k < cols; ++k)
+            m_cosX[k] = 2. * cos(M_PI * k / cols) - 2.;
     }
-
-    // right neighbor
-    ndx += 2;
-    if ((x+1) < xsize && !(flags[ndx])) {
-        grad = GRAD(phase[ndx] -phase[mid_ndx]); //right - middle
-        Insert_To_Do(val + grad, ndx, -fabs(grad));
+    if ((int)m_cosY.size() != rows){
+        m_cosY.resize(rows);
+        for (int k = 0; k < rows; ++k)
+            m_cosY[k] = 2. * cos(M_PI * k / rows) - 2.;
     }
 
-    //up neighbor
-    ndx = mid_ndx - xsize;
-    if ((y-1) >= 0  && !(flags[ndx]))
-    {
-        grad = GRAD(phase[ndx] -phase[mid_ndx]);  //up - middle
-        Insert_To_Do( val + grad, ndx, -fabs(grad));
+    // the weights and the phase padded to the even size in m_z
+    const char *flags = &m_flags[0];
+    bool masked = rows != ny || cols != nx;
+    m_weight.setTo(0.);
+    m_z.setTo(0.);
+    for (int y = 0; y < ny; ++y){
+        double *w = m_weight.ptr<double>(y);
+        double *z = m_z.ptr<double>(y);
+        for (int x = 0; x < nx; ++x){
+            int ndx = y*nx + x;
+            if (flags[ndx])
+                masked = true;
+            else {
+                w[x] = 1.;
+                z[x] = phase[ndx];
+            }
+        }
+    }
+    weightedLaplacian(m_z, m_r, true);
+
+    m_x.setTo(0.);
+    double bnorm = cv::norm(m_r);
+    if (!masked)
+        poisson(m_r, m_x);
+    else if (bnorm > 0.){
+        double rz = 0;
+        for (int k = 0; k < lsIterations; ++k){
+            poisson(m_r, m_z);
+            double rzNew = m_r.dot(m_z);
+            if (k == 0)
+                m_z.copyTo(m_p);
+            else
+                cv::scaleAdd(m_p, rzNew / rz, m_z, m_p);
+            rz = rzNew;
+            weightedLaplacian(m_p, m_ap, false);
+            double pap = m_p.dot(m_ap);
+            if (pap == 0.)
+                break;
+            double alpha = rz / pap;
+            cv::scaleAdd(m_p, alpha, m_x, m_x);
+            cv::scaleAdd(m_ap, -alpha, m_r, m_r);
+            if (cv::norm(m_r) <= lsTolerance * bnorm)
+                break;
+        }
     }
 
-    // down neighbor
-    ndx= (mid_ndx + xsize);
-    if ((y+1) < ysize && !(flags[ndx])) {
-        grad = GRAD(phase[ndx] - phase[mid_ndx]); // down - middle
-        Insert_To_Do(val + grad, ndx, -fabs(grad));
+    // The solution has an arbitrary piston.  Move it to where it differs from the wrapped phase by
+    // whole waves on average, then add the nearest whole waves to the wrapped phase.
+    double s = 0;
+    double c = 0;
+    for (int y = 0; y < ny; ++y){
+        const double *sol = m_x.ptr<double>(y);
+        for (int x = 0; x < nx; ++x){
+            int ndx = y*nx + x;
+            if (!flags[ndx]){
+                double d = 2. * M_PI * (sol[x] - phase[ndx]);
+                s += sin(d);
+                c += cos(d);
+            }
+        }
+    }
+    double offset = atan2(s, c) / (2. * M_PI);
+    for (int y = 0; y < ny; ++y){
+        const double *sol = m_x.ptr<double>(y);
+        for (int x = 0; x < nx; ++x){
+            int ndx = y*nx + x;
+            if (!flags[ndx])
+                unwrapped[ndx] = phase[ndx] + floor(sol[x] - offset - phase[ndx] + .5);
+        }
     }
 }
 
-/* quality guided path following for phase unwrapping */
-void QGPathFollower()
-{
-    int size = xsize * ysize;
-
-    for (int cur = 0; cur < size; ++cur)
-    {
-        if (!(flags[cur]))
-        {
-            double value = unwrapped[cur] = phase[cur];
-
-            // set unwrapped flag
-            flags[cur] =1;
-
-            Add_Neighbors( cur, value);
-
-            while (!To_Do.empty())
-            {
-                int ndx = To_Do.top().m_ndx;
-                To_Do.pop();
-
-                value = unwrapped[ndx];
+void phaseUnwrapper::reserve(int size){
+    if ((int)m_qmap.size() >= size)
+        return;
+    m_qmap.resize(size);
+    m_flags.resize(size);
+    m_todo.resize(size);
+}
 
-                Add_Neighbors( ndx, value);
+size_t phaseUnwrapper::bytes() const{
+    size_t total = m_qmap.size() * sizeof(double) + m_flags.size() + m_todo.size() * sizeof(int) + m_buckets.bytes();
+    const cv::Mat *mats[] = {&m_weight, &m_x, &m_r, &m_z, &m_p, &m_ap};
+    for (unsigned int i = 0; i < sizeof(mats)/sizeof(mats[0]); ++i)
+        total += mats[i]->total() * mats[i]->elemSize();
+    return total;
+}
 
-            }  //while
-        }
+void phaseUnwrapper::clear(){
+    std::vector<double>().swap(m_qmap);
+    std::vector<char>().swap(m_flags);
+    std::vector<int>().swap(m_todo);
+    std::vector<int>().swap(m_seeds);
+    m_buckets = qualityBucketQueue();
+    m_weight.release();
+    m_x.release();
+    m_r.release();
+    m_z.release();
+    m_p.release();
+    m_ap.release();
+    std::vector<double>().swap(m_cosX);
+    std::vector<double>().swap(m_cosY);
+}
 
+/* Input phase is scaled from 0 to 1 */
+void phaseUnwrapper::unwrap(const double *pphase, double *punwrapped, const char *mask, int nx, int ny,
+                            unwrapMethod method)
+{
+    const int size = nx * ny;
+    reserve(size);
+    memcpy(&m_flags[0], mask, size);
+    if (method == UNWRAP_LEAST_SQUARES){
+        leastSquares(pphase, punwrapped, nx, ny);
+        return;
     }
+    // make the quality map
+    dvQualityMap(pphase, 5, nx, ny);
 
+    regionSeeds(nx, ny, &m_qmap[0], &m_flags[0], &m_todo[0], m_seeds);
+    if (method == UNWRAP_BUCKETS){
+        m_buckets.reset(&m_qmap[0], &m_flags[0], size);
+        pathFollower(nx, ny, pphase, punwrapped, m_buckets);
+    }
+    else {
+        todoHeap todo(&m_qmap[0], &m_todo[0]);
+        pathFollower(nx, ny, pphase, punwrapped, todo);
+    }
 }
-void qg_path_follower (cv::Mat phase, double *qmap,
-                       double *unwrapped, double *path);
-
-void dv_quality_map (double *phase, int width, double *qmap, int nx, int ny);
-double* g_qqmap = NULL;
-double* path = NULL;
 
+phaseUnwrapper *phaseUnwrapper::forThread(){
+    static QThreadStorage<phaseUnwrapper *> unwrappers;
+    if (!unwrappers.hasLocalData())
+        unwrappers.setLocalData(new phaseUnwrapper);
+    return unwrappers.localData();
+}
 
 /* main entrypoint for unwrapping. Input phase is scaled from 0 to 1 */
-void unwrap(double * pphase, double *punwrapped, char* bflags, int nx, int ny)
+void unwrap(double * pphase, double *punwrapped, char* bflags, int nx, int ny, unwrapMethod method)
 {
-
-    xsize = nx;
-    ysize = ny;
-    unwrapped = punwrapped;
-    phase = pphase;
-
-  const int size = xsize * ysize;
-  flags = bflags;
-
-
-
-  /* initialize unwrapped array */
-
-   double* qmap;
-  // make the quality map
-   if (g_qqmap)
-    delete[] g_qqmap;
-
-  g_qqmap = qmap = new double[size];
-  memset(qmap,0, sizeof(double)*size);
-
-  // TODO JST 20230815 this limits memory leak but should be refactored with a object oriented programming
-  if(path){
-    delete[] path;
-  }
-  path = new double[size];
-  memset(path,0,sizeof(double)*size);
-
-  dv_quality_map(pphase, 5, qmap, nx, ny);
-  for (int i = 0; i < size; ++i)
-      qmap[i] *= -1.;
-
-
-  qg_path_follower(nx,ny,pphase, qmap, unwrapped, path);
-
+    phaseUnwrapper::forThread()->unwrap(pphase, punwrapped, bflags, nx, ny, method);
 }
 
 void vortex_rho_theta(int width, int height, double* rho, double* theta)
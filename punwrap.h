@@ -19,7 +19,110 @@
 #define PUNWRAP_H
 #include <opencv2/opencv.hpp>
 #include <opencv2/highgui/highgui.hpp>
-void unwrap(double *pphase, double *unwrapped, char *mask, int nx, int ny);
+#include <vector>
+
+// How the phase is unwrapped.  Stored as the index of the dft settings combo box.  The vortex
+// orientation is always path followed, in exact order unless UNWRAP_BUCKETS.
+enum unwrapMethod {
+    UNWRAP_EXACT,       // path following strictly best quality first with a binary heap
+    UNWRAP_BUCKETS,     // path following with the quality quantized into qualityBucketQueue buckets
+    UNWRAP_LEAST_SQUARES    // weighted least squares with a dct Poisson solver
+};
+
+// Pixel indexes popped best quality first with the quality quantized into buckets.  Push and pop are
+// O(1) where a heap is O(log n) and touch little memory, at the cost of taking pixels of nearly the
+// same quality in first in first out order instead of exactly by quality.
+class qualityBucketQueue {
+public:
+    enum {defaultBuckets = 4096};
+    // Empties the queue and spreads the buckets over the quality of the size pixels of qmap where skip
+    // is zero.  qmap must stay valid while the queue is used.
+    void reset(const double *qmap, const char *skip, int size, int buckets = defaultBuckets);
+    void push(int ndx){
+        int b = bucket(m_qmap[ndx]);
+        m_next[ndx] = -1;
+        if (m_tail[b] < 0)
+            m_head[b] = ndx;
+        else
+            m_next[m_tail[b]] = ndx;
+        m_tail[b] = ndx;
+        if (b > m_top)
+            m_top = b;
+        ++m_count;
+    }
+    int pop(){
+        while (m_head[m_top] < 0)
+            --m_top;
+        int ndx = m_head[m_top];
+        m_head[m_top] = m_next[ndx];
+        if (m_head[m_top] < 0)
+            m_tail[m_top] = -1;
+        --m_count;
+        return ndx;
+    }
+    bool empty() const { return m_count == 0; }
+    size_t bytes() const;
+
+private:
+    int bucket(double q) const {
+        int b = (int)((q - m_min) * m_scale);
+        return b < 0 ? 0 : (b > m_last ? m_last : b);
+    }
+    const double *m_qmap;
+    double m_min;
+    double m_scale;
+    int m_last;             // highest bucket
+    int m_top;              // no pixels above this bucket
+    int m_count;
+    std::vector<int> m_head;
+    std::vector<int> m_tail;
+    std::vector<int> m_next;    // per pixel link to the next one in its bucket
+};
+
+// The best quality pixel of each 4 connected region of pixels where flags is zero, best first.  The path
+// followers start each region from these instead of searching the whole image for every region so
+// masks with many islands stay linear in the number of pixels.  stack needs room for nx * ny indexes.
+void regionSeeds(int nx, int ny, const double *qmap, char *flags, int *stack, std::vector<int> &seeds);
+
+// Quality guided path following or least squares phase unwrapper.  The buffers are kept between calls
+// so unwrapping more phases of the same size allocates nothing.  Not thread safe; forThread() gives each thread its
+// own so phases can be unwrapped in parallel.  clear() frees the buffers when a surface is done.
+class phaseUnwrapper {
+public:
+    static phaseUnwrapper *forThread();
+    // phase is scaled from 0 to 1 and mask is non zero where there is no data.  nx * ny values.
+    void unwrap(const double *phase, double *unwrapped, const char *mask, int nx, int ny,
+                unwrapMethod method = UNWRAP_EXACT);
+    size_t bytes() const;
+    void clear();
+
+private:
+    void reserve(int size);
+    void dvQualityMap(const double *phase, int width, int nx, int ny);
+    template <typename Queue> void pathFollower(int nx, int ny, const double *phase, double *unwrapped,
+                                                Queue &todo);
+    void leastSquares(const double *phase, double *unwrapped, int nx, int ny);
+    void poisson(const cv::Mat &rhs, cv::Mat &result);
+    void weightedLaplacian(const cv::Mat &in, cv::Mat &out, bool wrap);
+    std::vector<double> m_qmap;
+    std::vector<char> m_flags;
+    std::vector<int> m_todo;       // heap, and the regionSeeds stack before that
+    std::vector<int> m_seeds;
+    qualityBucketQueue m_buckets;
+    // least squares, padded to even sizes for cv::dct
+    cv::Mat m_weight;               // 1 where there is data
+    cv::Mat m_x;                    // solution
+    cv::Mat m_r;                    // residual, starts as the wrapped laplacian
+    cv::Mat m_z;                    // preconditioned residual
+    cv::Mat m_p;                    // search direction
+    cv::Mat m_ap;
+    std::vector<double> m_cosX;     // dct eigenvalue terms 2 cos(pi k / n) - 2
+    std::vector<double> m_cosY;
+};
+
+// phaseUnwrapper::forThread()->unwrap()
+void unwrap(double *pphase, double *unwrapped, char *mask, int nx, int ny,
+            unwrapMethod method = UNWRAP_EXACT);
 
 
 #define BORDER      0x1
@@ -24,6 +24,8 @@ public:
     bool m_downsize;
     bool shouldDownsize(){ return m_downsize;}
     int wavefrontSize(){ return m_waveFrontSize;}
+    int m_memoryBudgetMB;
+    int memoryBudgetMB(){ return m_memoryBudgetMB;}
     double getObs();
 signals:
     void outputLambdaChanged(double val);
@@ -35,6 +37,7 @@ private slots:
     void on_starTestMakeCb_clicked(bool checked);
     void on_showConditionNumbersCb_clicked(bool checked);
     void on_wavefrontSizeSb_valueChanged(int arg1);
+    void on_memoryBudgetSb_valueChanged(int arg1);
     void on_downSizeCB_clicked(bool checked);
     void on_AstigDistGraphWidth_valueChanged(int val);
     void on_applyOffsets_clicked(bool checked);
@@ -31,6 +31,8 @@ settingsDFT::settingsDFT(QWidget *parent) :
     ui->flipVert->setChecked(flipv);
     fliph = set.value("DFT Flip Horizontal", false).toBool();
     ui->flipHorizontal->setChecked(fliph);
+    ui->singlePrecision->setChecked(set.value("DFT Single Precision", false).toBool());
+    ui->unwrapMethod->setCurrentIndex(set.value("DFT Unwrap Method", 0).toInt());
 }
 
 settingsDFT::~settingsDFT()
@@ -43,6 +45,14 @@ bool settingsDFT::showThumb(){
     return ui->ShowDFTTHumbCB->isChecked();
 }
 
+bool settingsDFT::singlePrecision(){
+    return ui->singlePrecision->isChecked();
+}
+
+int settingsDFT::unwrapMethod(){
+    return ui->unwrapMethod->currentIndex();
+}
+
 void settingsDFT::on_ShowDFTTHumbCB_clicked(bool)
 {
     QSettings set;
@@ -71,3 +81,15 @@ void settingsDFT::on_flipHorizontal_clicked(bool checked)
     fliph = checked;
     set.setValue("DFT Flip Horizontal", checked);
 }
+
+void settingsDFT::on_singlePrecision_clicked(bool checked)
+{
+    QSettings set;
+    set.setValue("DFT Single Precision", checked);
+}
+
+void settingsDFT::on_unwrapMethod_currentIndexChanged(int index)
+{
+    QSettings set;
+    set.setValue("DFT Unwrap Method", index);
+}
@@ -33,6 +33,8 @@ public:
     ~settingsDFT();
     bool showThumb();
     int DFTSize();
+    bool singlePrecision();
+    int unwrapMethod();     // unwrapMethod of punwrap.h
     bool flipv;
     bool fliph;
 
@@ -46,6 +48,10 @@ private slots:
 
     void on_flipHorizontal_clicked(bool checked);
 
+    void on_singlePrecision_clicked(bool checked);
+
+    void on_unwrapMethod_currentIndexChanged(int index);
+
 private:
     Ui::settingsDFT *ui;
 };
@@ -18,6 +18,10 @@ SettingsGeneral2::SettingsGeneral2(QWidget *parent) :
     m_useStarTestMakeOnly = set.value("useMakeStarTest", false).toBool();
     m_waveFrontSize = set.value("wavefrontDownSizeValue", 650).toInt();
     m_downsize = set.value("wavefrontShouldDownsize", false).toBool();
+    m_memoryBudgetMB = set.value("wavefrontMemoryBudgetMB", 4096).toInt();
+    ui->memoryBudgetSb->blockSignals(true);
+    ui->memoryBudgetSb->setValue(m_memoryBudgetMB);
+    ui->memoryBudgetSb->blockSignals(false);
     ui->downSizeCB->blockSignals(true);
     ui->wavefrontSizeSb->blockSignals(true);
     ui->downSizeCB->setChecked(m_downsize);
@@ -43,6 +47,12 @@ void SettingsGeneral2::on_wavefrontSizeSb_valueChanged(int arg1){
     set.setValue("wavefrontDownSizeValue", arg1);
 }
 
+void SettingsGeneral2::on_memoryBudgetSb_valueChanged(int arg1){
+    m_memoryBudgetMB = arg1;
+    QSettings set;
+    set.setValue("wavefrontMemoryBudgetMB", arg1);
+}
+
 void SettingsGeneral2::on_applyOffsets_clicked(bool checked){
    QSettings set;
    set.setValue("applyOffsets", checked);
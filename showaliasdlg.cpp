@@ -93,9 +93,14 @@ showAliasDlg::~showAliasDlg()
  }
 void showAliasDlg::contrast(){
     QImage temp = m_img.copy();
-    cv::Mat res(temp.height(),temp.width(),CV_8UC3,(uchar*)temp.bits(),temp.bytesPerLine());
+    if (temp.format() == QImage::Format_Grayscale8){
+        gray = cv::Mat(temp.height(),temp.width(),CV_8UC1,(uchar*)temp.bits(),temp.bytesPerLine()).clone();
+    }
+    else {
+        cv::Mat res(temp.height(),temp.width(),CV_8UC3,(uchar*)temp.bits(),temp.bytesPerLine());
 
-    cv::cvtColor(res,gray, cv::COLOR_RGB2GRAY);
+        cv::cvtColor(res,gray, cv::COLOR_RGB2GRAY);
+    }
 
     for( int y = 0; y < gray.rows; y++ ) {
         for( int x = 0; x < gray.cols; x++ ) {
@@ -292,7 +292,7 @@ void define_input::browse(){
 
     QStringList fileNames = QFileDialog::getOpenFileNames(this,
                         tr("Select average ffile"), basePath->text(),
-                        tr("wft (*.wft)"));
+                        tr("wft (*.wft *.wftb)"));
     if (fileNames.isEmpty())
         return;
     foreach (QString fileName, fileNames){
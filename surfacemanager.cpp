@@ -72,6 +72,12 @@
 #include "oglrendered.h"
 #include "ui_oglrendered.h"
 #include "spdlog/spdlog.h"
+#include "wavefrontfile.h"
+#include "wavefrontresidency.h"
+#include "wavefrontsaver.h"
+#include <QSaveFile>
+#include <QJsonArray>
+#include <QJsonDocument>
 
 cv::Mat theMask;
 cv::Mat deb;
@@ -345,6 +351,7 @@ void SurfaceManager::generateSurfacefromWavefront(int wavefrontNdx) {
 }
 
 void SurfaceManager::generateSurfacefromWavefront(wavefront * wf){
+    wavefrontResidency::get_Instance()->touch(wf);
     zernikeProcess &zp = *zernikeProcess::get_Instance();
     if (wf->dirtyZerns){
         if (mirrorDlg::get_Instance()->isEllipse()){
@@ -372,7 +379,10 @@ void SurfaceManager::generateSurfacefromWavefront(wavefront * wf){
         //compute zernike values
 
         mirrorDlg *md = mirrorDlg::get_Instance();
-        zp.unwrap_to_zernikes(*wf);
+        if (wf->zernsPrefit)    // already done by the wave front loader
+            wf->zernsPrefit = false;
+        else
+            zp.unwrap_to_zernikes(*wf);
         // check for swapped conic value
         if (!m_ignoreInverse && (md->cc != 0.0) && md->cc * wf->InputZerns[8] < 0.){
             bool reverse = false;
@@ -586,6 +596,21 @@ void SurfaceManager::makeMask(int waveNdx, bool useCenterCircle){
 
 
 void SurfaceManager::makeMask(wavefront *wf, bool useInsideCircle){
+    wavefrontResidency::get_Instance()->touch(wf);
+    cv::Mat mask = buildMask(wf, useInsideCircle);
+    theMask = mask.clone();
+
+    if (Settings2::showMask())
+        showData("surface manager mask",mask);
+}
+
+// Sets the wave front mask and work mask.  Only reads the mirror config and mask offsets so it is
+// safe to call from the wave front loader worker threads.
+cv::Mat SurfaceManager::buildMask(wavefront *wf, bool useInsideCircle){
+    return buildMask(wf, outsideOffset, insideOffset, useInsideCircle);
+}
+
+cv::Mat SurfaceManager::buildMask(wavefront *wf, int outsideOffset, int insideOffset, bool useInsideCircle){
     int width = wf->data.cols;
     int height = wf->data.rows;
     double xm,ym;
@@ -669,7 +694,6 @@ void SurfaceManager::makeMask(wavefront *wf, bool useInsideCircle){
     //line(wf->workMask, Point(s/2, 0), Point(s/2,s),cv::Scalar(0,0,0), 10);
    // line(wf->workMask, Point(0, s/2), Point(s,s/2),cv::Scalar(0,0,0), 10);
     //line(wf->workMask, Point(0, 0), Point(s,s),cv::Scalar(0,0,0), 10);
-    theMask = mask.clone();
 
     
     // add central obstruction (not to be confused with a hole in the mirror - this comes from mirror configuration)
@@ -680,10 +704,7 @@ void SurfaceManager::makeMask(wavefront *wf, bool useInsideCircle){
         cv::Mat m = wf->workMask;
         circle(m,Point((m.cols-1)/2,(m.cols-1)/2),r, Scalar(0),-1);
     }
-
-    if (Settings2::showMask())
-        showData("surface manager mask",mask);
-
+    return mask;
 }
 void SurfaceManager::wftNameChanged(int ndx, QString name){
     m_wavefronts[ndx]->name = name;
@@ -691,6 +712,7 @@ void SurfaceManager::wftNameChanged(int ndx, QString name){
 }
 
 void SurfaceManager::sendSurface(wavefront* wf){
+    wavefrontResidency::get_Instance()->setDisplayed(wf);
     emit currentNdxChanged(m_currentNdx);
     computeMetrics(wf);
 
@@ -780,6 +802,7 @@ void SurfaceManager::waveFrontClickedSlot(int ndx)
 {
 
     m_currentNdx = ndx;
+    wavefrontResidency::get_Instance()->touch(m_wavefronts[ndx]);
     QString msg = QString(" %1x%2 ").arg(m_wavefronts[ndx]->data.cols).arg(m_wavefronts[ndx]->data.rows);
     ((MainWindow*)parent())->statusBar()->showMessage(msg);
     sendSurface(m_wavefronts[ndx]);
@@ -843,6 +866,7 @@ void SurfaceManager::surfaceSmoothGBEnabled(bool b){
 }
 
 void SurfaceManager::computeMetrics(wavefront *wf){
+    wavefrontResidency::get_Instance()->touch(wf);
     mirrorDlg *md = mirrorDlg::get_Instance();
     cv::Scalar mean,std;
     cv::meanStdDev(wf->workData,mean,std,wf->workMask);
@@ -905,53 +929,41 @@ void SurfaceManager::computeZerns()
     m_waveFrontTimer->start(500);
 }
 
-void SurfaceManager::writeWavefront(QString fname, wavefront *wf, bool saveNulled){
-        std::ofstream file((fname.toStdString().c_str()));
-
-        if (!file.is_open()) {
-            QMessageBox::warning(0, tr("Write wave front"),
-                                 tr("Cannot write file %1: ")
-                                 .arg(fname));
-            return;
-        }
-        file << wf->data.cols << std::endl << wf->data.rows << std::endl;
-        for (int row = wf->data.rows - 1; row >=0; --row){
-            for (int col = 0; col < wf->data.cols ; ++col){
-                if (saveNulled)
-                    file << wf->workData(row,col) << '\n';
-                else {
-                    file << wf->data(row,col) << '\n';
-
-                }
-            }
-        }
-        int offsetOutside = 0;
-        QSettings set;
-        if (set.value("applyOffsets", false).toBool()){
-            offsetOutside = outsideOffset;
-        }
-
-        file << "outside ellipse " <<
-                       wf->m_outside.m_center.x()
-             << " " << wf->m_outside.m_center.y()
-             << " " << wf->m_outside.m_radius + offsetOutside
-             << " "  << wf->m_outside.m_radius << std:: endl;
-
-
-        if (wf->m_inside.m_radius > 0){
-            file << "obstruction ellipse " << wf->m_inside.m_center.x()
-             << " " << wf->m_inside.m_center.y()
-             << " " << wf->m_inside.m_radius + ((set.value("applyOffsets", false).toBool()) ? insideOffset: 0)
-             << " " << wf->m_inside.m_radius << std:: endl;
-        }
+// Copy what is needed to write wf so it can be written on another thread.
+wavefrontSaveJob SurfaceManager::makeSaveJob(QString fname, wavefront *wf, bool saveNulled){
+    wavefrontResidency::get_Instance()->touch(wf);
+    QSettings set;
+    bool applyOffsets = set.value("applyOffsets", false).toBool();
+    mirrorDlg &md = *mirrorDlg::get_Instance();
+    wavefrontSaveJob job;
+    job.fileName = fname;
+    job.data = (saveNulled ? wf->workData : wf->data).clone();
+    wavefrontFileInfo &info = job.info;
+    info.outsideX = wf->m_outside.m_center.x();
+    info.outsideY = wf->m_outside.m_center.y();
+    info.outsideRadius = wf->m_outside.m_radius + (applyOffsets ? outsideOffset : 0);
+    job.outsideRadius = wf->m_outside.m_radius;
+    job.insideRadius = wf->m_inside.m_radius;
+    if (wf->m_inside.m_radius > 0){
+        info.insideX = wf->m_inside.m_center.x();
+        info.insideY = wf->m_inside.m_center.y();
+        info.insideRadius = wf->m_inside.m_radius + (applyOffsets ? insideOffset : 0);
+    }
+    info.diameter = wf->diameter;
+    info.roc = wf->roc;
+    info.lambda = wf->lambda;
+    info.isEllipse = md.isEllipse();
+    info.ellipseVerticalAxis = md.m_verticalAxis;
+    info.nulled = !wf->useSANull;
+    return job;
+}
 
-        file << "DIAM " << wf->diameter << std::endl;
-        file << "ROC " << wf->roc << std::endl;
-        file << "Lambda " << wf->lambda << std::endl;
-        mirrorDlg &md = *mirrorDlg::get_Instance();
-        if (md.isEllipse()){
-            file << "ellipse_vertical_axis " << md.m_verticalAxis;
-        }
+void SurfaceManager::writeWavefront(QString fname, wavefront *wf, bool saveNulled){
+    if (!writeWavefrontFile(makeSaveJob(fname, wf, saveNulled))){
+        QMessageBox::warning(0, tr("Write wave front"),
+                             tr("Cannot write file %1: ")
+                             .arg(fname));
+    }
 }
 
 void SurfaceManager::SaveWavefronts(bool saveNulled){
@@ -965,7 +977,7 @@ void SurfaceManager::SaveWavefronts(bool saveNulled){
         QString file = fileinfo.baseName();
         fileName = QFileDialog::getSaveFileName(0,
              tr("Write wave font file"), lastPath + "/" + file,
-             tr("wft (*.wft)"));
+             tr("wft (*.wft);;binary wft (*.wftb)"));
         if (fileName.isEmpty()){
             QApplication::restoreOverrideCursor();
             return;
@@ -989,42 +1001,315 @@ void SurfaceManager::SaveWavefronts(bool saveNulled){
             QApplication::restoreOverrideCursor();
             return;
         }
-        // find last file in dir
-
-        QProgressDialog progress("Saving wavefront files", "Cancel", 0, list.size(), 0);
-        progress.setWindowModality(Qt::WindowModal);
-        progress.setValue(0);
+        QList<wavefront *> wfs;
+        QStringList fileNames;
+        QStringList existing;
         for (int i = 0; i < list.size(); ++i){
-            progress.setValue(i+1);
-
             wavefront *wf = m_wavefronts[list[i]];
-            progress.setLabelText(wf->name);
-
             QString fname = wf->name;
             QStringList fnparts = fname.split("/");
             if (fnparts.size() > 1)
                 fname = fnparts[fnparts.size()-1];
             if (QFileInfo(fname).suffix().isEmpty()) { fname.append(".wft");}
             QString fullPath = dir + QDir::separator() + fname;
-            QFileInfo info;
-            // check if file exists and if yes: Is it really a file and no directory?
-            if (info.exists(fullPath)) {
-                if (QMessageBox::question(0,"file alread exists", fullPath +" already exists. Do you want to overwrite it?") ==
-                        QMessageBox::No)
-                    continue;
-
+            if (QFileInfo::exists(fullPath))
+                existing << fullPath;
+            // same name twice. Written in parallel so only keep the last one as writing in order would.
+            int dup = fileNames.indexOf(fullPath);
+            if (dup >= 0){
+                fileNames.removeAt(dup);
+                wfs.removeAt(dup);
+            }
+            wfs << wf;
+            fileNames << fullPath;
+        }
+        // ask once for the whole batch
+        if (existing.size() > 0){
+            QApplication::restoreOverrideCursor();
+            int resp = QMessageBox::question(0, "files already exist",
+                    QString("%1 of the %2 files already exist in %3.\nDo you want to overwrite them?\n"
+                            "No will save only the files that do not exist.")
+                            .arg(existing.size()).arg(fileNames.size()).arg(dir),
+                    QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
+            if (resp == QMessageBox::Cancel)
+                return;
+            if (resp == QMessageBox::No){
+                for (int i = fileNames.size() - 1; i >= 0; --i){
+                    if (existing.contains(fileNames[i])){
+                        fileNames.removeAt(i);
+                        wfs.removeAt(i);
+                    }
+                }
+            }
+            QApplication::setOverrideCursor(Qt::WaitCursor);
+        }
+        waveFrontSaver *saver = new waveFrontSaver(this, wfs, fileNames, saveNulled);
+        saver->start();
+    }
+    QApplication::restoreOverrideCursor();
+}
+// Session file (.dfts).  Magic, version and the size of a json document describing the mirror config and
+// every loaded wave front followed by the raw pixel blocks of the wave fronts.  Restoring does not need
+// any of the zernike fitting, nulling or smoothing done when a wave front is loaded.
+#define SESSION_MAGIC "DFTSESS"
+#define SESSION_VERSION 1
+
+static QJsonObject sessionMatJson(const cv::Mat &m, qint64 &offset){
+    QJsonObject obj;
+    obj["rows"] = m.rows;
+    obj["cols"] = m.cols;
+    obj["type"] = m.type();
+    obj["offset"] = (double)offset;
+    offset += m.total() * m.elemSize();
+    return obj;
+}
+
+static bool writeSessionMat(QIODevice &file, const cv::Mat &m){
+    const qint64 rowBytes = m.cols * m.elemSize();
+    for (int row = 0; row < m.rows; ++row){
+        if (file.write((const char *)m.ptr(row), rowBytes) != rowBytes)
+            return false;
+    }
+    return true;
+}
+
+static bool readSessionMat(QFile &file, qint64 dataStart, const QJsonObject &obj, cv::Mat &m){
+    int rows = obj["rows"].toInt();
+    int cols = obj["cols"].toInt();
+    if (rows == 0 || cols == 0){
+        m.release();
+        return true;
+    }
+    m.create(rows, cols, obj["type"].toInt());
+    qint64 bytes = m.total() * m.elemSize();
+    return file.seek(dataStart + (qint64)obj["offset"].toDouble()) &&
+            file.read((char *)m.data, bytes) == bytes;
+}
+
+bool SurfaceManager::saveSession(const QString &fileName){
+    QJsonObject session;
+    session["version"] = SESSION_VERSION;
+    session["mirror"] = mirrorDlg::get_Instance()->configJson();
+    QJsonArray enables;
+    for (unsigned int i = 0; i < zernEnables.size(); ++i)
+        enables.append((bool)zernEnables[i]);
+    session["zernEnables"] = enables;
+    session["insideOffset"] = insideOffset;
+    session["outsideOffset"] = outsideOffset;
+
+    QList<wavefront *> wfs;
+    foreach(wavefront *wf, m_wavefronts){
+        if (wf->name != "Demo")
+            wfs << wf;
+    }
+    session["current"] = wfs.indexOf(getCurrent());
+
+    qint64 offset = 0;
+    QJsonArray wavefronts;
+    foreach(wavefront *wf, wfs){
+        wavefrontResidency::get_Instance()->touch(wf);
+        QJsonObject w;
+        w["name"] = wf->name;
+        w["lambda"] = wf->lambda;
+        w["diameter"] = wf->diameter;
+        w["roc"] = wf->roc;
+        w["useSANull"] = wf->useSANull;
+        w["wasSmoothed"] = wf->wasSmoothed;
+        w["GBSmoothingValue"] = wf->GBSmoothingValue;
+        w["gaussian_diameter"] = wf->gaussian_diameter;
+        w["min"] = wf->min;
+        w["max"] = wf->max;
+        w["std"] = wf->std;
+        w["mean"] = wf->mean;
+        QJsonObject outside, inside;
+        wf->m_outside.toJson(outside);
+        wf->m_inside.toJson(inside);
+        w["outside"] = outside;
+        w["inside"] = inside;
+        QJsonArray zerns;
+        for (unsigned int z = 0; z < wf->InputZerns.size(); ++z)
+            zerns.append(wf->InputZerns[z]);
+        w["zernikes"] = zerns;
+        QJsonArray regions;
+        for (int n = 0; n < wf->regions.size(); ++n){
+            QJsonArray points;
+            for (unsigned int i = 0; i < wf->regions[n].size(); ++i){
+                points.append(wf->regions[n][i].x);
+                points.append(wf->regions[n][i].y);
             }
-            qApp->processEvents();
-            writeWavefront(fullPath, wf, saveNulled);
+            regions.append(points);
+        }
+        w["regions"] = regions;
+        w["regionsExpanded"] = wf->regions_have_been_expanded;
+        w["data"] = sessionMatJson(wf->data, offset);
+        w["mask"] = sessionMatJson(wf->mask, offset);
+        w["workData"] = sessionMatJson(wf->workData, offset);
+        w["workMask"] = sessionMatJson(wf->workMask, offset);
+        wavefronts.append(w);
+    }
+    session["wavefronts"] = wavefronts;
+
+    QByteArray json = QJsonDocument(session).toJson(QJsonDocument::Compact);
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    char magic[8] = SESSION_MAGIC;
+    quint32 version[2] = {SESSION_VERSION, 0};
+    quint64 jsonBytes = json.size();
+    file.write(magic, sizeof(magic));
+    file.write((const char *)version, sizeof(version));
+    file.write((const char *)&jsonBytes, sizeof(jsonBytes));
+    file.write(json);
+    foreach(wavefront *wf, wfs){
+        wavefrontResidency::get_Instance()->touch(wf);
+        if (!writeSessionMat(file, wf->data) || !writeSessionMat(file, wf->mask) ||
+                !writeSessionMat(file, wf->workData) || !writeSessionMat(file, wf->workMask)){
+            file.cancelWriting();
+            return false;
+        }
+    }
+    return file.commit();
+}
 
+bool SurfaceManager::restoreSession(const QString &fileName){
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)){
+        QMessageBox::warning(0, tr("Restore session"), tr("Cannot read file %1").arg(fileName));
+        return false;
+    }
+    char magic[8];
+    quint32 version[2];
+    quint64 jsonBytes = 0;
+    if (file.read(magic, sizeof(magic)) != (qint64)sizeof(magic) || memcmp(magic, SESSION_MAGIC, sizeof(magic)) != 0 ||
+            file.read((char *)version, sizeof(version)) != (qint64)sizeof(version) ||
+            file.read((char *)&jsonBytes, sizeof(jsonBytes)) != (qint64)sizeof(jsonBytes) ||
+            jsonBytes > (quint64)file.size()){
+        QMessageBox::warning(0, tr("Restore session"), tr("%1 is not a DFTFringe session file.").arg(fileName));
+        return false;
+    }
+    if (version[0] > SESSION_VERSION){
+        QMessageBox::warning(0, tr("Restore session"), tr("%1 was saved by a newer version of DFTFringe.").arg(fileName));
+        return false;
+    }
+    QJsonObject session = QJsonDocument::fromJson(file.read(jsonBytes)).object();
+    qint64 dataStart = file.pos();
 
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    mirrorDlg::get_Instance()->setConfigJson(session["mirror"].toObject());
+    QJsonArray enables = session["zernEnables"].toArray();
+    for (int i = 0; i < enables.size() && i < (int)zernEnables.size(); ++i)
+        zernEnables[i] = enables[i].toBool();
+    insideOffset = session["insideOffset"].toInt();
+    outsideOffset = session["outsideOffset"].toInt();
+
+    if (m_currentNdx == 0 && m_wavefronts.size() > 0 && m_wavefronts[0]->name == "Demo"){
+        deleteCurrent();
+    }
+
+    int first = m_wavefronts.size();
+    bool ok = true;
+    QJsonArray wavefronts = session["wavefronts"].toArray();
+    for (int n = 0; n < wavefronts.size(); ++n){
+        QJsonObject w = wavefronts[n].toObject();
+        wavefront *wf = new wavefront();
+        wf->name = w["name"].toString();
+        wf->lambda = w["lambda"].toDouble();
+        wf->diameter = w["diameter"].toDouble();
+        wf->roc = w["roc"].toDouble();
+        wf->useSANull = w["useSANull"].toBool();
+        wf->wasSmoothed = w["wasSmoothed"].toBool();
+        wf->GBSmoothingValue = w["GBSmoothingValue"].toDouble();
+        wf->gaussian_diameter = w["gaussian_diameter"].toDouble();
+        wf->min = w["min"].toDouble();
+        wf->max = w["max"].toDouble();
+        wf->std = w["std"].toDouble();
+        wf->mean = w["mean"].toDouble();
+        wf->m_outside = CircleOutline(w["outside"].toObject());
+        wf->m_inside = CircleOutline(w["inside"].toObject());
+        QJsonArray zerns = w["zernikes"].toArray();
+        wf->InputZerns = std::vector<double>(zerns.size(), 0.);
+        for (int z = 0; z < zerns.size(); ++z)
+            wf->InputZerns[z] = zerns[z].toDouble();
+        QJsonArray regions = w["regions"].toArray();
+        for (int r = 0; r < regions.size(); ++r){
+            QJsonArray points = regions[r].toArray();
+            std::vector<cv::Point> region;
+            for (int i = 0; i + 1 < points.size(); i += 2)
+                region.push_back(cv::Point(points[i].toInt(), points[i+1].toInt()));
+            wf->regions << region;
+        }
+        wf->regions_have_been_expanded = w["regionsExpanded"].toBool();
+        cv::Mat data, mask, workData, workMask;
+        if (!readSessionMat(file, dataStart, w["data"].toObject(), data) ||
+                !readSessionMat(file, dataStart, w["mask"].toObject(), mask) ||
+                !readSessionMat(file, dataStart, w["workData"].toObject(), workData) ||
+                !readSessionMat(file, dataStart, w["workMask"].toObject(), workMask)){
+            delete wf;
+            ok = false;
+            break;
         }
+        wf->data = data;
+        wf->mask = mask;
+        wf->workData = workData;
+        wf->workMask = workMask;
+        wf->dirtyZerns = false;
+
+        m_wavefronts << wf;
+        m_surfaceTools->addWaveFront(wf->name);
+        wavefrontResidency::get_Instance()->touch(wf);
+    }
+
+    if (m_wavefronts.size() > first){
+        int current = session["current"].toInt();
+        m_currentNdx = (current >= 0 && first + current < m_wavefronts.size()) ? first + current : m_wavefronts.size() - 1;
+        m_surfaceTools->select(m_currentNdx);
+        loadComplete();
+    }
+    else if (m_wavefronts.size() == 0){
+        useDemoWaveFront();
     }
     QApplication::restoreOverrideCursor();
+    if (!ok)
+        QMessageBox::warning(0, tr("Restore session"), tr("%1 is incomplete. Not all wave fronts were restored.").arg(fileName));
+    return ok;
 }
+
 void SurfaceManager::createSurfaceFromPhaseMap(cv::Mat phase, CircleOutline outside,
                                                CircleOutline center,
                                                QString name, QVector<std::vector<Point> > polyArea){
+    setSurfaceFromPhaseMap(phase, outside, center, name, polyArea, 0);
+}
+
+// A background surface job shows its low resolution surface under previewId.  A later preview with
+// the same id replaces it.
+void SurfaceManager::createPreviewFromPhaseMap(int previewId, cv::Mat phase, CircleOutline outside,
+                                               CircleOutline center,
+                                               QString name, QVector<std::vector<Point> > polyArea){
+    m_previews[previewId] = setSurfaceFromPhaseMap(phase, outside, center, name + " preview", polyArea,
+                                                   m_previews.value(previewId, 0));
+}
+
+// the full resolution surface of the job goes into its preview entry.
+void SurfaceManager::replacePreviewFromPhaseMap(int previewId, cv::Mat phase, CircleOutline outside,
+                                                CircleOutline center,
+                                                QString name, QVector<std::vector<Point> > polyArea){
+    setSurfaceFromPhaseMap(phase, outside, center, name, polyArea, m_previews.take(previewId));
+}
+
+// remove the preview when its full resolution surface was canceled or failed.
+void SurfaceManager::discardPreview(int previewId){
+    int ndx = m_wavefronts.indexOf(m_previews.take(previewId));
+    if (ndx < 0)
+        return;
+    m_currentNdx = ndx;
+    deleteCurrent();
+}
+
+// replace is reused when it is still in the list.  Otherwise the surface is added as a new wave front.
+wavefront *SurfaceManager::setSurfaceFromPhaseMap(cv::Mat phase, CircleOutline outside,
+                                                  CircleOutline center,
+                                                  QString name, QVector<std::vector<Point> > polyArea,
+                                                  wavefront *replace){
 
     wavefront *wf;
 
@@ -1046,7 +1331,13 @@ void SurfaceManager::createSurfaceFromPhaseMap(cv::Mat phase, CircleOutline outs
 
     }
 
-    if (m_wavefronts.size() >0 && (m_currentNdx == 0 &&  m_wavefronts[0]->name == "Demo")){
+    int replaceNdx = replace ? m_wavefronts.indexOf(replace) : -1;
+    if (replaceNdx >= 0){
+        wf = replace;
+        wf->name = name;
+        m_surfaceTools->nameChanged(replaceNdx, name);
+    }
+    else if (m_wavefronts.size() >0 && (m_currentNdx == 0 &&  m_wavefronts[0]->name == "Demo")){
         qDebug() << "using demo";
         wf = m_wavefronts[0];
         emit nameChanged(wf->name, name);
@@ -1072,7 +1363,7 @@ void SurfaceManager::createSurfaceFromPhaseMap(cv::Mat phase, CircleOutline outs
     wf->dirtyZerns = true;
     wf->wasSmoothed = false;
     wf->regions = polyArea;
-    m_currentNdx = m_wavefronts.size()-1;
+    m_currentNdx = replaceNdx >= 0 ? replaceNdx : m_wavefronts.size()-1;
 
     makeMask(m_currentNdx);
 
@@ -1080,75 +1371,72 @@ void SurfaceManager::createSurfaceFromPhaseMap(cv::Mat phase, CircleOutline outs
     loadComplete();
     m_surfaceTools->select(m_currentNdx);
     emit showTab(2);
+    return wf;
 }
 
 wavefront * SurfaceManager::readWaveFront(QString fileName){
-    std::ifstream file(fileName.toStdString().c_str());
-    if (!file) {
-        QString b = "Can not read file " + fileName + " " +strerror(errno);
-        QMessageBox::warning(NULL, tr("Read Wavefront File"),b);
+    wavefrontFileInfo info = defaultFileInfo();
+    QString errorMsg;
+    wavefront *wf = readWaveFrontFile(fileName, info, errorMsg);
+    if (!wf) {
+        QMessageBox::warning(NULL, tr("Read Wavefront File"),errorMsg);
         return 0;
     }
-    wavefront *wf = new wavefront();
-    double width;
-    double height;
-    file >> width;
-    file >> height;
-    cv::Mat data(height,width, numType,0.);
-
-    for( size_t y = 0; y < height; y++ ) {
-        for( size_t x = 0; x < width; x++ ) {
-            file >> data.at<double>(height - y-1,x);
-            //data.at<double>(height - y - 1, x) += dist(generator);
+    applyWaveFrontFileInfo(wf, info);
+    return wf;
+}
+
+// The mirror config roc, lambda and diameter used for .wft files that do not have them.  Reads the
+// mirror config so call it on the gui thread.
+wavefrontFileInfo SurfaceManager::defaultFileInfo(){
+    mirrorDlg *md = mirrorDlg::get_Instance();
+    wavefrontFileInfo info;
+    info.roc = md->roc;
+    info.lambda = md->lambda;
+    info.diameter = md->diameter;
+    return info;
+}
+
+// Reads the pixels and header values of a .wft or .wftb file.  info starts as defaultFileInfo().
+// Does not touch the mirror config or the gui so it can be run from a worker thread.
+wavefront *SurfaceManager::readWaveFrontFile(const QString &fileName, wavefrontFileInfo &info, QString &errorMsg){
+    if (isBinaryWavefrontFile(fileName)){
+        cv::Mat_<double> data;
+        if (!readBinaryWavefront(fileName, data, info)){
+            errorMsg = "Can not read file " + fileName + " it is not a valid wftb file.";
+            return 0;
         }
+        wavefront *wf = new wavefront();
+        wf->data = data;
+        return wf;
     }
 
-    std::string line;
-    QString l;
-    mirrorDlg *md = mirrorDlg::get_Instance();
+    cv::Mat_<double> data;
+    if (!readAsciiWavefront(fileName, data, info)) {
+        errorMsg = "Can not read file " + fileName + " " +
+                (QFile::exists(fileName) ? QString("it is not a valid wft file.") : QString(strerror(errno)));
+        return 0;
+    }
+    wavefront *wf = new wavefront();
+    wf->data = data;
+    return wf;
+}
 
-    double xm = (width-1)/2.,ym = (height-1)/2.,
-            radm = min(xm,ym)-2 ,
-            roc = md->roc,
-            lambda = md->lambda,
-            diam = md->diameter;
-    double xo = width/2., yo = height/2., rado = 0;
-
-    std::string dummy;
-    while (getline(file, line)) {
-        l = QString::fromStdString(line);
-        std::istringstream iss(line);
-        if (l.startsWith("outside")) {
-            QStringList sl = l.split(" ");
-            xm = sl[2].toDouble();
-            radm = sl[4].toDouble();
-            ym = sl[3].toDouble();
-            continue;
-        }
-        if (l.startsWith("DIAM")){
-            iss >> dummy >> diam;
-            continue;
-        }
-        if (l.startsWith("ROC")){
-            iss >> dummy >> roc;
-            continue;
-        }
-        if (l.startsWith("Lambda")){
-            iss >> dummy >> lambda;
-            continue;
-        }
-        if (l.startsWith("obstruction")){
-            iss >> dummy >> dummy >> xo >> yo >> rado;
-            continue;
-        }
-        if (l.startsWith("ellipse_vertical_axis")){
-            md->m_outlineShape = ELLIPSE;
-            iss >> dummy >> md->m_verticalAxis;
-        }
-        if (l.startsWith("nulled")){
-            wf->useSANull = false;
-        }
+// apply the outlines and mirror values read from a wave front file and check them against the mirror config.
+void SurfaceManager::applyWaveFrontFileInfo(wavefront *wf, const wavefrontFileInfo &info){
+    mirrorDlg *md = mirrorDlg::get_Instance();
+    if (info.isEllipse){
+        md->m_outlineShape = ELLIPSE;
+        md->m_verticalAxis = info.ellipseVerticalAxis;
+    }
+    if (info.nulled){
+        wf->useSANull = false;
     }
+    double xm = info.outsideX, ym = info.outsideY, radm = info.outsideRadius,
+            roc = info.roc,
+            lambda = info.lambda,
+            diam = info.diameter;
+    double xo = info.insideX, yo = info.insideY, rado = info.insideRadius;
 
     wf->m_outside = CircleOutline(QPointF(xm,ym), radm);
     if (rado == 0){
@@ -1245,12 +1533,9 @@ wavefront * SurfaceManager::readWaveFront(QString fileName){
         }
     }
     wf->diameter = diam;
-    wf->data= data;
     wf->roc = roc;
     wf->lambda = lambda;
     wf->wasSmoothed = false;
-
-    return wf;
 }
 void SurfaceManager::downSizeWf(wavefront *wf){
     int newcols, newrows;
@@ -1286,19 +1571,32 @@ bool SurfaceManager::loadWavefront(const QString &fileName){
     }
 
         wf = readWaveFront(fileName);
-        m_wavefronts << wf;
-
-        wf->name = fileName;
-
-        m_surfaceTools->addWaveFront(wf->name);
-        m_currentNdx = m_wavefronts.size()-1;
-        m_surfaceTools->select(m_currentNdx);
+        if (!wf)
+            return mirrorParamsChanged;
 
     // if resize to smaller
     if (Settings2::getInstance()->m_general->shouldDownsize()){
         downSizeWf(wf);
     }
-    makeMask(m_currentNdx);
+    makeMask(wf);
+
+    addLoadedWavefront(wf, fileName);
+
+    return mirrorParamsChanged;
+}
+
+// Add a wave front that has been read and masked to the list and generate its surface.
+void SurfaceManager::addLoadedWavefront(wavefront *wf, const QString &fileName){
+    if (m_currentNdx == 0 && m_wavefronts.size() > 0 && m_wavefronts[0]->name == "Demo"){
+        deleteCurrent();
+    }
+    m_wavefronts << wf;
+
+    wf->name = fileName;
+
+    m_surfaceTools->addWaveFront(wf->name);
+    m_currentNdx = m_wavefronts.size()-1;
+    m_surfaceTools->select(m_currentNdx);
 
     m_surface_finished = false;
     try {
@@ -1308,14 +1606,15 @@ bool SurfaceManager::loadWavefront(const QString &fileName){
         deleteCurrent();
         throw i;
     }
-
-    return mirrorParamsChanged;
 }
 void SurfaceManager::deleteCurrent(){
     if (m_wavefronts.size() == 0)
         return;
     if (m_wavefronts.length()) {
         emit deleteWavefront(m_currentNdx);
+        QList<int> previews = m_previews.keys(m_wavefronts[m_currentNdx]);
+        foreach(int id, previews)
+            m_previews.remove(id);
         delete m_wavefronts[m_currentNdx];
         m_wavefronts.removeAt(m_currentNdx);
 
@@ -1528,6 +1827,7 @@ void SurfaceManager::average(QList<wavefront *> wfList){
 
     QHash<QString,QList<int>> sizes;
     for (int i = 0; i < wfList.size(); ++i){
+        wavefrontResidency::get_Instance()->touch(wfList[i]);
         QString size =  QString("%1 %2").arg(wfList[i]->data.rows).arg(wfList[i]->data.cols);
         if (sizes.find(size)!= sizes.end())
         {
@@ -1560,16 +1860,17 @@ void SurfaceManager::average(QList<wavefront *> wfList){
 
     QApplication::setOverrideCursor(Qt::WaitCursor);
 qDebug() << "maxkey" << maxkey << rrows << rcols << sizes[maxkey];
+    wavefrontResidency::get_Instance()->touch(wfList[sizes[maxkey][0]]);
     cv::Mat mask = wfList[sizes[maxkey][0]]->workMask.clone();
     if (mask.cols != rcols || mask.rows != rrows){
         cv::resize(mask,mask,Size(rrows,rcols));
     }
 
-    cv::Mat sum = cv::Mat::zeros(rrows,rcols, m_wavefronts[m_currentNdx]->data.type());
+    cv::Mat sum = cv::Mat::zeros(rrows,rcols, CV_64F);
     cv::Mat resizedImage;
 
     for (int j = 0; j < wfList.size(); ++j){
-
+        wavefrontResidency::get_Instance()->touch(wfList[j]);
         cv::Mat resizedMask = wfList[j]->workMask.clone();
         resizedImage = wfList[j]->data;
         if (resizedMask.cols != rcols || resizedMask.rows != rrows){
@@ -1586,6 +1887,7 @@ qDebug() << "maxkey" << maxkey << rrows << rcols << sizes[maxkey];
 
 
     wavefront *wf = new wavefront();
+    wavefrontResidency::get_Instance()->touch(wfList[sizes[maxkey][0]]);
     *wf = *wfList[sizes[maxkey][0]];// copy in all the parameters (e.g. m_inside, lambda, diameter) from first wavefront to average
     wf->data = sum.clone();
     wf->mask = mask;
@@ -1679,6 +1981,7 @@ void SurfaceManager::rotateThese(double angle, QList<int> list){
     pd->setRange(0, list.size());
     for (int i = 0; i < list.size(); ++i) {
         wavefront *oldWf = m_wavefronts[list[i]];
+        wavefrontResidency::get_Instance()->touch(oldWf);
         QStringList l = oldWf->name.split('.');
         QString newName = QString("%1_%2%3.wft").arg(l[0]).arg((angle >= 0) ? "CW":"CCW").arg(fabs(angle), 5, 'f', 1, QLatin1Char('0')); // clazy:exclude=qstring-arg
         wavefront *wf = new wavefront();
@@ -1738,6 +2041,8 @@ void SurfaceManager::rotateThese(double angle, QList<int> list){
 }
 
 void SurfaceManager::subtract(wavefront *wf1, wavefront *wf2, bool use_null){
+    wavefrontResidency::get_Instance()->touch(wf2);
+    wavefrontResidency::get_Instance()->touch(wf1);
 
     int size1 = wf1->data.rows * wf1->data.cols;
     int size2 = wf2->data.rows * wf2->data.cols;
@@ -1808,6 +2113,7 @@ void SurfaceManager::invert(QList<int> list){
     pd->setLabelText("Inverting Wavefronts");
     pd->setRange(0, list.size());
     for (int i = 0; i < list.size(); ++i) {
+        wavefrontResidency::get_Instance()->touch(m_wavefronts[list[i]]);
         m_wavefronts[list[i]]->data *= -1;
         m_wavefronts[list[i]]->dirtyZerns = true;
         m_wavefronts[list[i]]->wasSmoothed = false;
@@ -1865,6 +2171,7 @@ double wrapAngle(double angle){
     return angle;
 }
 void SurfaceManager::inspectWavefront(){
+    wavefrontResidency::get_Instance()->touch(m_wavefronts[m_currentNdx]);
     wex = new wftExaminer(m_wavefronts[m_currentNdx]);
     wex->show();
 }
@@ -1943,6 +2250,7 @@ textres SurfaceManager::Phase2(QList<rotationDef *> list, QList<wavefront *> inp
     QVector<double> astigMag;
     editor->resize(printer.pageLayout().paintRectPixels(printer.resolution()).size());
     doc->setPageSize(printer.pageLayout().paintRectPixels(printer.resolution()).size());
+    wavefrontResidency::get_Instance()->touch(inputs[0]);
     cv::Mat standavg = cv::Mat::zeros(inputs[0]->workData.size(), numType);
     cv::Mat standavgZernMat = cv::Mat::zeros(inputs[0]->workData.size(), numType);
     double mirrorXaverage = 0;
@@ -1963,6 +2271,7 @@ textres SurfaceManager::Phase2(QList<rotationDef *> list, QList<wavefront *> inp
         subtract(inputs[i], m_wavefronts[ndx],false);
         ++ndx;      // now ndx point to the stand only wavefront
         while(!m_surface_finished){qApp->processEvents();}
+        wavefrontResidency::get_Instance()->touch(m_wavefronts[ndx]);
         cv::Mat resized = m_wavefronts[ndx]->workData.clone();
         if (standavg.cols != m_wavefronts[ndx]->workData.cols || standavg.rows != m_wavefronts[ndx]->workData.rows){
             cv::resize(m_wavefronts[ndx]->workData, resized, Size(standavg.cols, standavg.rows));
@@ -1981,6 +2290,7 @@ textres SurfaceManager::Phase2(QList<rotationDef *> list, QList<wavefront *> inp
         for (int ii = 9; ii < Z_TERMS; ++ii)
             zernsToUse << ii;
 
+        wavefrontResidency::get_Instance()->touch(inputs[0]);
         cv::Mat m = computeWaveFrontFromZernikes(inputs[0]->data.cols,inputs[0]->data.rows,
                 m_wavefronts[ndx]->InputZerns, zernsToUse );
         standavgZernMat += m;
@@ -2450,6 +2760,7 @@ void SurfaceManager::computeStandAstig(define_input *wizPage, QList<rotationDef
         wavefront * wf = m_wavefronts[m_currentNdx];
         inputs.append(wf);
         unrotatedNdxs.append(m_currentNdx);
+        wavefrontResidency::get_Instance()->touch(wf);
         plot->setSurface(wf);
         plot->replot();
         renderer.render( plot, &painter, QRect(0,0,contourWidth,contourHeight) );
@@ -2473,6 +2784,7 @@ void SurfaceManager::computeStandAstig(define_input *wizPage, QList<rotationDef
         wf = m_wavefronts[ndx];
 
         loadComplete();
+        wavefrontResidency::get_Instance()->touch(wf);
         plot->setSurface(wf);
         plot->replot();
 
@@ -2517,6 +2829,7 @@ void SurfaceManager::computeStandAstig(define_input *wizPage, QList<rotationDef
             "<h3>Step 2. Averaged surface with stand induced terms removed:</h3>");
     ContourPlot *plotAvg =new ContourPlot(0,0,false);//m_contourPlot;
 
+    wavefrontResidency::get_Instance()->touch(m_wavefronts[m_currentNdx]);
     plotAvg->setSurface(m_wavefronts[m_currentNdx]);
     contour = QImage(550,450, QImage::Format_ARGB32 );
     contour.fill( QColor( Qt::white ).rgb() );
@@ -2668,6 +2981,7 @@ void SurfaceManager::showAllContours(){
     for (int i = 0; i < list.size(); ++i)
     {
         wavefront * wf = m_wavefronts[list[i]];
+        wavefrontResidency::get_Instance()->touch(wf);
         plot->setSurface(wf);
         plot->replot();
         int y_offset =  height * (i/columns) + 10;
@@ -3006,6 +3320,7 @@ void SurfaceManager::memoryLow(){
         okToContinue = resp;
 }
 void SurfaceManager::resize( wavefront *wf, int size){
+    wavefrontResidency::get_Instance()->touch(wf);
     wavefront *nwf = new wavefront();
     *nwf = *wf;
     nwf->dirtyZerns = true;
@@ -3030,6 +3345,7 @@ void SurfaceManager::resize( wavefront *wf, int size){
 
 }
 void SurfaceManager::changeWavelength( wavefront *wf, double wavelength){
+    wavefrontResidency::get_Instance()->touch(wf);
     wavefront *nwf = new wavefront();
     *nwf = *wf;
     nwf->dirtyZerns = true;
@@ -3044,6 +3360,7 @@ void SurfaceManager::changeWavelength( wavefront *wf, double wavelength){
     generateSurfacefromWavefront(m_currentNdx);
 }
 void SurfaceManager::flipHorizontal( wavefront *wf){
+    wavefrontResidency::get_Instance()->touch(wf);
     cv::Mat newData;
     cv::Mat newMask;
     cv::flip(wf->data, newData, 1);
@@ -3069,6 +3386,7 @@ void SurfaceManager::flipHorizontal( wavefront *wf){
     generateSurfacefromWavefront(m_currentNdx);
 }
 void SurfaceManager::flipVertical( wavefront *wf){
+    wavefrontResidency::get_Instance()->touch(wf);
     cv::Mat newData;
     cv::Mat newMask;
     cv::flip(wf->data, newData, 0);
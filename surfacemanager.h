@@ -35,6 +35,7 @@
 #include "mirrordlg.h"
 #include "metricsdisplay.h"
 #include <QTimer>
+#include <QHash>
 #include <QProgressDialog>
 #include "wftstats.h"
 #include "Circleoutline.h"
@@ -43,6 +44,8 @@
 #include "standastigwizard.h"
 #include <QPointF>
 #include "surfacegraph.h"
+#include "wavefrontfile.h"
+#include "wavefrontresidency.h"
 enum configRESPONSE { YES, NO, ASK};
 struct textres {
     QTextEdit *Edit;
@@ -71,6 +74,9 @@ public:
     void saveAllWaveFrontStats();
     void SaveWavefronts(bool saveNulled);
     void writeWavefront(QString fname, wavefront *wf, bool saveNulled);
+    wavefrontSaveJob makeSaveJob(QString fname, wavefront *wf, bool saveNulled);
+    bool saveSession(const QString &fileName);
+    bool restoreSession(const QString &fileName);
     void useDemoWaveFront();
     void showUnwrap();
     void initWaveFrontLoad();
@@ -78,9 +84,13 @@ public:
     void downSizeWf(wavefront *wf);
     void process(int wavefront_index, SurfaceManager *sm);
     wavefront *readWaveFront(QString fileName);
+    static wavefront *readWaveFrontFile(const QString &fileName, wavefrontFileInfo &info, QString &errorMsg);
+    static wavefrontFileInfo defaultFileInfo();
+    void applyWaveFrontFileInfo(wavefront *wf, const wavefrontFileInfo &info);
     inline wavefront *getCurrent(){
         if (m_wavefronts.size() == 0)
             return 0;
+        wavefrontResidency::get_Instance()->touch(m_wavefronts[m_currentNdx]);
         return m_wavefronts[m_currentNdx];
     }
     cv::Mat computeWaveFrontFromZernikes(int wx,int wy, std::vector<double> &zerns, QVector<int> zernsToUse);
@@ -119,6 +129,9 @@ public:
     int okToContinue;
     bool okToUpdateSurfacesOnGenerateComplete;
     void makeMask(wavefront* wf, bool useInsideCircle = true);
+    cv::Mat buildMask(wavefront* wf, bool useInsideCircle = true);
+    static cv::Mat buildMask(wavefront* wf, int outsideOffset, int insideOffset, bool useInsideCircle = true);
+    void addLoadedWavefront(wavefront *wf, const QString &fileName);
     void generateSurfacefromWavefront(int ndx);
     void generateSurfacefromWavefront(wavefront *wf);
     void transform();
@@ -132,6 +145,10 @@ private:
     int workProgress;
 
     wftStats *m_wftStats;
+    QHash<int, wavefront *> m_previews;    // preview id of a background surface job to its wave front
+
+    wavefront *setSurfaceFromPhaseMap(cv::Mat phase, CircleOutline outside, CircleOutline center, QString name,
+                                      QVector<std::vector<cv::Point> > polyArea, wavefront *replace);
 
     explicit SurfaceManager(QObject *parent=0, surfaceAnalysisTools *tools = 0, ProfilePlot *profilePlot =0,
                    contourView *contourView = 0, SurfaceGraph *glPlot = 0, metricsDisplay *mets = 0);
@@ -181,6 +198,14 @@ public slots:
     void createSurfaceFromPhaseMap(cv::Mat phase, CircleOutline outside,
                                    CircleOutline center, QString name,
                                    QVector<std::vector<cv::Point> > polyArea= QVector<std::vector<cv::Point> >());
+    // low resolution surface shown until replacePreviewFromPhaseMap with the same id replaces it
+    void createPreviewFromPhaseMap(int previewId, cv::Mat phase, CircleOutline outside,
+                                   CircleOutline center, QString name,
+                                   QVector<std::vector<cv::Point> > polyArea);
+    void replacePreviewFromPhaseMap(int previewId, cv::Mat phase, CircleOutline outside,
+                                    CircleOutline center, QString name,
+                                    QVector<std::vector<cv::Point> > polyArea);
+    void discardPreview(int previewId);
     void invert(QList<int> list);
     void wftNameChanged(int, QString);
     void showAllContours();
@@ -0,0 +1,327 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+// unwrapbench: speed and correctness of the phase unwrappers.
+//
+//   unwrapbench --size 1024 --repeat 5 -o unwrap.json
+//
+// Each case is a zernike surface made by makeSurfaceFromZerns with optional noise, a central obstruction
+// and ignore polygons, wrapped to fractions of a wave like the vortex phase is before it is unwrapped.
+// Every unwrap method unwraps every case.  For each run the json has the first and median wall time, the
+// bytes of unwrapper buffers, and the number of neighbouring pixel pairs where the unwrapped surface steps
+// by more than half a wave against the surface that was wrapped.  Keep the json of each version to track
+// regressions.
+//
+// Exit codes: 0 done, 1 bad arguments, 2 the json could not be written.
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include "punwrap.h"
+#include "zernikeprocess.h"
+#include "zernikesmoothingdlg.h"
+#include "mirrordlg.h"
+#include "settings2.h"
+#include "spdlog/spdlog.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+enum benchExitCode {
+    BENCH_OK = 0,
+    BENCH_USAGE = 1,
+    BENCH_OUTPUT = 2
+};
+
+// zernike order of the surfaces, piston through spherical
+static const int benchOrder = 4;
+
+// Zernike values in waves at a size of 1024.  They are scaled with the size so the surfaces have the same
+// fringes per pixel at every size.
+static const struct {
+    const char *name;
+    double zerns[9];
+} surfaces[] = {
+    {"defocus",     {0, 0, 0, 15, 0, 0, 0, 0, 0}},
+    {"astig coma",  {0, 0, 0, 4, 5, 0, 0, 3, 0}},
+    {"spherical",   {0, 0, 0, -3, 0, 0, 0, 0, 6}}
+};
+
+static const struct {
+    const char *name;
+    bool noise;
+    bool obstruction;
+    bool polygons;
+} conditions[] = {
+    {"clean",       false, false, false},
+    {"noise",       true,  false, false},
+    {"obstruction", false, true,  false},
+    {"polygons",    false, false, true},
+    {"all",         true,  true,  true}
+};
+
+static const struct {
+    const char *name;
+    unwrapMethod method;
+} methods[] = {
+    {"exact",           UNWRAP_EXACT},
+    {"buckets",         UNWRAP_BUCKETS},
+    {"least-squares",   UNWRAP_LEAST_SQUARES}
+};
+
+struct benchOptions {
+    int size;
+    int repeat;
+    double noise;           // rms waves
+    double obstruction;     // fraction of the radius
+    int seed;
+};
+
+struct benchResult {
+    int pixels;
+    double firstMs;         // includes making the unwrapper buffers
+    double medianMs;
+    size_t peakBytes;       // unwrapper buffers, which only grow
+    int discontinuities;    // neighbour pairs that step by more than half a wave against the expected surface
+    int errorPixels;        // pixels more than half a wave from the expected surface
+};
+
+// The surface with noise that is wrapped, the wrapped phase from 0 to 1 and the mask the unwrappers take,
+// 1 where there is no data.
+static void makeCase(const cv::Mat &truth, const cv::Mat &onGrid, int condition, const benchOptions &opt,
+                     cv::Mat &expected, cv::Mat &wrapped, cv::Mat &mask){
+    const int size = truth.rows;
+    const double radius = (size - 1) / 2.;
+    const cv::Point center(size / 2, size / 2);
+
+    expected = truth.clone();
+    if (conditions[condition].noise){
+        cv::RNG rng(opt.seed + condition);
+        cv::Mat noise(truth.size(), CV_64F);
+        rng.fill(noise, cv::RNG::NORMAL, 0., opt.noise);
+        expected += noise;
+    }
+
+    mask = 1 - onGrid;
+    if (conditions[condition].obstruction)
+        cv::circle(mask, center, (int)(opt.obstruction * radius), cv::Scalar(1), -1);
+    if (conditions[condition].polygons){
+        // a spider vane and a chip at the edge
+        std::vector<std::vector<cv::Point> > poly(2);
+        int vane = std::max(2, size / 60);
+        poly[0].push_back(cv::Point(0, center.y - vane));
+        poly[0].push_back(cv::Point(size - 1, center.y - vane / 2));
+        poly[0].push_back(cv::Point(size - 1, center.y + vane / 2));
+        poly[0].push_back(cv::Point(0, center.y + vane));
+        poly[1].push_back(cv::Point(center.x, 0));
+        poly[1].push_back(cv::Point(center.x + size / 5, 0));
+        poly[1].push_back(cv::Point(center.x + size / 10, size / 6));
+        cv::fillPoly(mask, poly, cv::Scalar(1));
+    }
+
+    wrapped = cv::Mat::zeros(truth.size(), CV_64F);
+    expected.setTo(0., mask);
+    for (int y = 0; y < size; ++y){
+        const double *e = expected.ptr<double>(y);
+        const uchar *m = mask.ptr<uchar>(y);
+        double *w = wrapped.ptr<double>(y);
+        for (int x = 0; x < size; ++x){
+            if (!m[x])
+                w[x] = e[x] - floor(e[x]);
+        }
+    }
+}
+
+static benchResult runCase(const cv::Mat &expected, const cv::Mat &wrapped, const cv::Mat &mask,
+                           unwrapMethod method, int repeat){
+    benchResult r;
+    phaseUnwrapper unwrapper;
+    cv::Mat result;
+    std::vector<double> times;
+    for (int i = 0; i < repeat; ++i){
+        result = cv::Mat::zeros(wrapped.size(), CV_64F);
+        QElapsedTimer timer;
+        timer.start();
+        unwrapper.unwrap(wrapped.ptr<double>(0), result.ptr<double>(0), (const char *)mask.data,
+                         wrapped.cols, wrapped.rows, method);
+        times.push_back(timer.nsecsElapsed() / 1.e6);
+    }
+    r.firstMs = times[0];
+    std::sort(times.begin(), times.end());
+    r.medianMs = times[times.size() / 2];
+    r.peakBytes = unwrapper.bytes();
+
+    // The unwrapped surface may be off by a piston, and by whole waves on islands of the mask, so the
+    // steps between neighbours are what count.
+    cv::Mat err = result - expected;
+    std::vector<double> errs;
+    r.discontinuities = 0;
+    for (int y = 0; y < err.rows; ++y){
+        const double *e = err.ptr<double>(y);
+        const double *below = y < err.rows - 1 ? err.ptr<double>(y + 1) : 0;
+        const uchar *m = mask.ptr<uchar>(y);
+        const uchar *mBelow = below ? mask.ptr<uchar>(y + 1) : 0;
+        for (int x = 0; x < err.cols; ++x){
+            if (m[x])
+                continue;
+            errs.push_back(e[x]);
+            if (x < err.cols - 1 && !m[x + 1] && fabs(e[x + 1] - e[x]) > .5)
+                ++r.discontinuities;
+            if (below && !mBelow[x] && fabs(below[x] - e[x]) > .5)
+                ++r.discontinuities;
+        }
+    }
+    r.pixels = (int)errs.size();
+    r.errorPixels = 0;
+    if (!errs.empty()){
+        std::vector<double>::iterator mid = errs.begin() + errs.size() / 2;
+        std::nth_element(errs.begin(), mid, errs.end());
+        double piston = *mid;
+        for (size_t i = 0; i < errs.size(); ++i){
+            if (fabs(errs[i] - piston) > .5)
+                ++r.errorPixels;
+        }
+    }
+    return r;
+}
+
+int main(int argc, char *argv[])
+{
+    // The zernike grid needs the mirror config widget so a QApplication is needed but nothing is shown.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    app.setOrganizationName("DFTFringe");
+    app.setApplicationName("unwrapbench");      // keep the settings apart from the gui
+    app.setApplicationVersion(APP_VERSION);
+
+    auto logger = spdlog::stderr_color_mt("logger");
+    logger->set_pattern("[%^%l%$] %v");
+    logger->set_level(spdlog::level::warn);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the phase unwrappers on wrapped zernike surfaces and counts their unwrap errors.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Json file for the results.  Default is stdout.", "file");
+    QCommandLineOption sizeOption("size", "Width and height of the surfaces.  Default 1024.", "pixels", "1024");
+    QCommandLineOption repeatOption("repeat", "Times each case is unwrapped.  Default 3.", "count", "3");
+    QCommandLineOption noiseOption("noise", "Rms noise in waves of the noisy cases.  Default .05.", "waves", ".05");
+    QCommandLineOption obstructionOption("obstruction", "Central obstruction in percent of the diameter.  Default 25.", "percent", "25");
+    QCommandLineOption seedOption("seed", "Random seed of the noise.  Default 1.", "seed", "1");
+    QCommandLineOption verboseOption(QStringList() << "v" << "verbose", "Print each run.");
+    parser.addOptions(QList<QCommandLineOption>() << outputOption << sizeOption << repeatOption << noiseOption
+                      << obstructionOption << seedOption << verboseOption);
+    parser.process(app);
+
+    benchOptions opt;
+    bool ok = true;
+    opt.size = parser.value(sizeOption).toInt(&ok);
+    if (!ok || opt.size < 32){
+        fputs("size must be at least 32\n", stderr);
+        return BENCH_USAGE;
+    }
+    opt.repeat = parser.value(repeatOption).toInt(&ok);
+    if (!ok || opt.repeat < 1){
+        fputs("repeat must be at least 1\n", stderr);
+        return BENCH_USAGE;
+    }
+    opt.noise = parser.value(noiseOption).toDouble(&ok);
+    if (!ok || opt.noise < 0){
+        fputs("noise must be a number >= 0\n", stderr);
+        return BENCH_USAGE;
+    }
+    opt.obstruction = .01 * parser.value(obstructionOption).toDouble(&ok);
+    if (!ok || opt.obstruction < 0 || opt.obstruction >= 1){
+        fputs("obstruction must be from 0 to less than 100\n", stderr);
+        return BENCH_USAGE;
+    }
+    opt.seed = parser.value(seedOption).toInt(&ok);
+    if (!ok){
+        fputs("seed must be a number\n", stderr);
+        return BENCH_USAGE;
+    }
+    if (parser.isSet(verboseOption))
+        logger->set_level(spdlog::level::info);
+
+    // made here on the gui thread like the gui does.  Plain zernikes whatever the saved config says.
+    Settings2::getInstance();
+    mirrorDlg::get_Instance()->m_useAnnular = false;
+    zernikeProcess *zp = zernikeProcess::get_Instance();
+    zp->m_bDontProcessEvents = true;
+    double radius = (opt.size - 1) / 2.;
+    zp->initGrid(opt.size, radius, radius, radius, benchOrder);
+    cv::Mat onGrid = cv::Mat::zeros(opt.size, opt.size, CV_8U);
+    for (size_t i = 0; i < zp->m_row.size(); ++i)
+        onGrid.at<uchar>(zp->m_row[i], zp->m_col[i]) = 1;
+
+    QJsonArray runs;
+    for (unsigned int s = 0; s < sizeof(surfaces)/sizeof(surfaces[0]); ++s){
+        std::vector<double> zerns(surfaces[s].zerns, surfaces[s].zerns + 9);
+        for (size_t z = 0; z < zerns.size(); ++z)
+            zerns[z] *= opt.size / 1024.;
+        cv::Mat truth = makeSurfaceFromZerns(opt.size, *zp, zerns);
+        for (unsigned int c = 0; c < sizeof(conditions)/sizeof(conditions[0]); ++c){
+            cv::Mat expected, wrapped, mask;
+            makeCase(truth, onGrid, c, opt, expected, wrapped, mask);
+            for (unsigned int m = 0; m < sizeof(methods)/sizeof(methods[0]); ++m){
+                benchResult r = runCase(expected, wrapped, mask, methods[m].method, opt.repeat);
+                logger->info("{} {} {}: {:.1f} ms, {} discontinuities", surfaces[s].name, conditions[c].name,
+                             methods[m].name, r.medianMs, r.discontinuities);
+                QJsonObject run;
+                run["surface"] = surfaces[s].name;
+                run["condition"] = conditions[c].name;
+                run["method"] = methods[m].name;
+                run["pixels"] = r.pixels;
+                run["firstMs"] = r.firstMs;
+                run["medianMs"] = r.medianMs;
+                run["peakBytes"] = (double)r.peakBytes;
+                run["discontinuities"] = r.discontinuities;
+                run["errorPixels"] = r.errorPixels;
+                runs.append(run);
+            }
+        }
+    }
+
+    QJsonObject doc;
+    doc["program"] = "unwrapbench";
+    doc["version"] = APP_VERSION;
+    doc["size"] = opt.size;
+    doc["repeat"] = opt.repeat;
+    doc["noise"] = opt.noise;
+    doc["obstruction"] = opt.obstruction;
+    doc["seed"] = opt.seed;
+    doc["runs"] = runs;
+    QByteArray json = QJsonDocument(doc).toJson();
+
+    QFile f;
+    bool opened;
+    if (parser.isSet(outputOption)){
+        f.setFileName(parser.value(outputOption));
+        opened = f.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    else
+        opened = f.open(stdout, QIODevice::WriteOnly);
+    if (!opened || f.write(json) != json.size()){
+        logger->error("cannot write {}", parser.isSet(outputOption) ? parser.value(outputOption).toStdString() : "stdout");
+        return BENCH_OUTPUT;
+    }
+    return BENCH_OK;
+}
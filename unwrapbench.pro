@@ -0,0 +1,21 @@
+# unwrapbench: times the phase unwrappers on wrapped zernike surfaces and writes the results as json.
+# Builds the same sources as DFTFringe with its own main.  Build it in its own build directory, for example
+#   mkdir build-bench && cd build-bench && qmake ../unwrapbench.pro && make
+# Run unwrapbench --help for the options.
+
+include(DFTFringe.pro)
+
+TARGET = unwrapbench
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES -= main.cpp
+SOURCES += unwrapbench.cpp
+
+macx {
+    # keep the objects apart from the gui build which uses the same DESTDIR
+    MOC_DIR = $$DESTDIR/.moc-bench
+    OBJECTS_DIR = $$DESTDIR/.obj-bench
+    RCC_DIR = $$DESTDIR/.qrc-bench
+    UI_DIR = $$DESTDIR/.ui-bench
+}
@@ -0,0 +1,642 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#include "vortex.h"
+#include "dftarea.h"
+#include "myutils.h"
+#include "punwrap.h"
+#include <queue>
+#include <QDebug>
+#include <QMutex>
+#include <QThreadStorage>
+#include <QtConcurrent>
+
+#define WRAP(x) (((x) > 0.5) ? ((x)-1.0) : (((x) <= -0.5) ? ((x)+1.0) : (x)))
+#define WRAPPI(x) (((x) > M_PI) ? ((x)-2*M_PI) : (((x) <= -M_PI) ? ((x)+2*M_PI) : (x)))
+
+class comp_qual {
+public:
+  comp_qual(const double *qmap): m_qmap(qmap){}
+  bool operator() (const int &p1, const int &p2) const {
+    return (m_qmap[p1] < m_qmap[p2]);
+  }
+private:
+  const double *m_qmap;
+};
+
+// std::priority_queue with the interface of qualityBucketQueue
+class qualityHeap {
+public:
+  qualityHeap(const double *qmap): m_todo((comp_qual(qmap))){}
+  void push(int ndx){ m_todo.push(ndx); }
+  int pop(){ int ndx = m_todo.top(); m_todo.pop(); return ndx; }
+  bool empty() const { return m_todo.empty(); }
+private:
+  std::priority_queue<int, std::vector<int>, comp_qual> m_todo;
+};
+#define unwrap_and_insert(ndx, val) \
+  { \
+    unwrapped[ndx] = val;  \
+    flags[ndx] |= UNWRAPPED; \
+    path[ndx] = order++; \
+    todo.push (ndx); \
+  }
+
+// Quality-guided path following phase unwrapper.  flags must be marked with the border and seeds
+// made by regionSeeds.
+template <typename Queue>
+static void qg_path_follower_vortex (Size size, double *phase, double *qmap,
+               double *unwrapped, double *path, char *flags, const std::vector<int> &seeds, Queue &todo)
+{
+  int order = 0;
+
+  // One pass for each disjoint region.
+  for (size_t s = 0; s < seeds.size(); ++s) {
+    int mndx = seeds[s];
+
+    // Unwrap the first point.
+    unwrap_and_insert (mndx, phase[mndx]);
+
+    // Unwrap the rest of the points in order of quality.
+    while (!todo.empty()) {
+      int ndx = todo.pop();
+      int x = ndx%size.width;
+      int y = ndx/size.width;
+      double val = unwrapped[ndx];
+      if (x > 0 && ! flags[ndx-1])
+    unwrap_and_insert (ndx-1, val+WRAP(phase[ndx-1]-phase[ndx]));
+      if (x < size.width-1 && ! flags[ndx+1])
+    unwrap_and_insert (ndx+1, val+WRAP(phase[ndx+1]-phase[ndx]));
+      if (y > 0 && ! flags[ndx-size.width])
+    unwrap_and_insert (ndx-size.width, val+WRAP(phase[ndx-size.width]-phase[ndx]));
+      if (y < size.height-1 && ! flags[ndx+size.width])
+    unwrap_and_insert (ndx+size.width, val+WRAP(phase[ndx+size.width]-phase[ndx]));
+    }
+  }
+}
+
+static void qg_path_follower_vortex (Size size, double *phase, double *qmap,
+               double *unwrapped, double *path, char *flags, int *stack, std::vector<int> &seeds,
+               qualityBucketQueue &buckets, unwrapMethod method)
+{
+  // Initialize the flags array to mark the border.
+  int total = size.area();
+  for (int k=0; k < total; ++k)
+    flags[k] = phase[k] == 0.0;
+  regionSeeds(size.width, size.height, qmap, flags, stack, seeds);
+
+  if (method == UNWRAP_BUCKETS){
+    buckets.reset(qmap, flags, total);
+    qg_path_follower_vortex(size, phase, qmap, unwrapped, path, flags, seeds, buckets);
+  }
+  else {
+    qualityHeap todo(qmap);
+    qg_path_follower_vortex(size, phase, qmap, unwrapped, path, flags, seeds, todo);
+  }
+}
+
+vortexParams::vortexParams():
+    low(0), smooth(9), showInput(false), showFdom(false), showOrientation(false),
+    showFdom3(false), showWrapped(false), singlePrecision(false), unwrapper(UNWRAP_EXACT)
+{
+}
+
+// Runs body(begin, end) over ranges of pixel indexes on the opencv thread pool.  The ranges are whole
+// rows so each thread works on its own cache lines.
+template <typename F>
+static void forPixels(int rows, int cols, const F &body){
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range &r){
+        body(r.start * cols, r.end * cols);
+    });
+}
+
+// Frequency tables shared by the engines of all threads.  They are read only once made so the
+// workspaces of a batch running on several threads use the same ones.
+enum vortexTableKind {
+    TABLE_RHO2,             // squared distance from dc in frequency bins
+    TABLE_SPIRAL,           // exp(i theta) of the frequency bins
+    TABLE_HIGHPASS,         // 1 - exp(-rho^2/low^2)
+    TABLE_SMOOTH            // exp(-rho^2/smooth^2)
+};
+
+struct vortexTable {
+    int kind;
+    cv::Size size;
+    int depth;
+    double value;
+    cv::Mat table;
+};
+
+static QMutex tableMutex;
+static QList<vortexTable> tables;       // most recently used first
+static const int maxTables = 8;
+
+static cv::Mat makeTable(int kind, cv::Size size, int depth, double value){
+    int xsize = size.width;
+    int ysize = size.height;
+    if (kind == TABLE_HIGHPASS || kind == TABLE_SMOOTH){
+        cv::Mat r2 = makeTable(TABLE_RHO2, size, CV_64F, 0);
+        const double *r = r2.ptr<double>(0);
+        cv::Mat g(size, CV_64F);
+        double *gp = g.ptr<double>(0);
+        double v2 = value * value;
+        bool highPass = kind == TABLE_HIGHPASS;
+        forPixels(ysize, xsize, [&](int begin, int end){
+            for (int i = begin; i < end; ++i)
+                gp[i] = highPass ? 1. - exp (-r[i]/v2) : exp (-r[i]/v2);
+        });
+        if (depth == CV_64F)
+            return g;
+        cv::Mat t;
+        g.convertTo(t, depth);
+        return t;
+    }
+
+    // Create rho and theta arrays for later use.
+    std::vector<int> ix(xsize), iy(ysize);
+    for (int i=0; i<=xsize/2; ++i) ix[i] = -i;
+    for (int i=1; i<=xsize/2; ++i) ix[xsize-i] = i;
+    for (int i=0; i<=ysize/2; ++i) iy[i] = -i;
+    for (int i=1; i<=ysize/2; ++i) iy[ysize-i] = i;
+
+    cv::Mat t(size, kind == TABLE_RHO2 ? CV_64F : CV_64FC2);
+    for (int j=0; j<ysize; ++j) {
+        if (kind == TABLE_RHO2){
+            double *r = t.ptr<double>(j);
+            for (int i=0; i<xsize; ++i)
+                r[i] = ix[i]*ix[i] + iy[j]*iy[j];
+        }
+        else {
+            cv::Vec2d *sp = t.ptr<cv::Vec2d>(j);
+            for (int i=0; i<xsize; ++i) {
+                double theta = atan2 (iy[j], ix[i]);
+                sp[i] = cv::Vec2d(cos(theta), sin(theta));
+            }
+        }
+    }
+    if (depth != CV_64F)
+        t.convertTo(t, depth);
+    return t;
+}
+
+static cv::Mat sharedTable(int kind, cv::Size size, int depth, double value = 0){
+    QMutexLocker lock(&tableMutex);
+    for (int i = 0; i < tables.size(); ++i){
+        const vortexTable &t = tables[i];
+        if (t.kind == kind && t.size == size && t.depth == depth && t.value == value){
+            tables.move(i, 0);
+            return tables[0].table;
+        }
+    }
+    vortexTable t;
+    t.kind = kind;
+    t.size = size;
+    t.depth = depth;
+    t.value = value;
+    t.table = makeTable(kind, size, depth, value);
+    tables.prepend(t);
+    // a workspace still using a dropped table keeps it alive until it is done
+    while (tables.size() > maxTables)
+        tables.removeLast();
+    return t.table;
+}
+
+// Buffers for one padded size and precision.  cv::Mat allocations are 64 byte aligned.
+struct VortexEngine::workspace {
+    cv::Size size;
+    int depth;              // CV_32F or CV_64F of the dft buffers
+    cv::Mat rho2;           // squared distance from dc in frequency bins
+    cv::Mat spiral;         // exp(i theta) of the frequency bins
+    cv::Mat highPass;       // 1 - exp(-rho^2/low^2) for highPassLow
+    double highPassLow;
+    cv::Mat smooth;         // exp(-rho^2/smooth^2) for smoothValue
+    double smoothValue;
+    cv::Mat input;          // real
+    cv::Mat fdom;           // complex
+    cv::Mat d1;
+    cv::Mat d2;
+    cv::Mat r;
+    cv::Mat temp;
+    cv::Mat imRe;           // real
+    cv::Mat imIm;
+    cv::Mat orient;         // double for the unwrap
+    cv::Mat qmap;
+    cv::Mat dir;
+    cv::Mat path;
+    cv::Mat mask;
+    std::vector<char> flags;
+    std::vector<int> seedStack;
+    std::vector<int> seeds;
+    qualityBucketQueue buckets;
+    workspace(cv::Size s, int d);
+    size_t bytes() const;
+    template <typename T> const T *highPassTable(double low);
+    template <typename T> const T *smoothTable(double smooth);
+};
+
+VortexEngine::workspace::workspace(cv::Size s, int d): size(s), depth(d), highPassLow(-1), smoothValue(-1)
+{
+    rho2 = sharedTable(TABLE_RHO2, s, d);
+    spiral = sharedTable(TABLE_SPIRAL, s, d);
+
+    int complexType = CV_MAKETYPE(d, 2);
+    input.create(s, d);
+    fdom.create(s, complexType);
+    d1.create(s, complexType);
+    d2.create(s, complexType);
+    r.create(s, complexType);
+    temp.create(s, complexType);
+    imRe.create(s, d);
+    imIm.create(s, d);
+    orient.create(s, CV_64F);
+    qmap.create(s, CV_64F);
+    dir.create(s, CV_64F);
+    path.create(s, CV_64F);
+    mask.create(s, CV_8U);
+    flags.resize(s.area());
+    seedStack.resize(s.area());
+}
+
+size_t VortexEngine::workspace::bytes() const{
+    const cv::Mat *mats[] = {&rho2, &spiral, &highPass, &smooth, &input, &fdom, &d1, &d2, &r, &temp, &imRe, &imIm,
+                             &orient, &qmap, &dir, &path, &mask};
+    size_t total = flags.size() + (seedStack.size() + seeds.size()) * sizeof(int) + buckets.bytes();
+    for (unsigned int i = 0; i < sizeof(mats)/sizeof(mats[0]); ++i)
+        total += mats[i]->total() * mats[i]->elemSize();
+    return total;
+}
+
+VortexEngine::VortexEngine(): m_last(0)
+{
+}
+
+VortexEngine::~VortexEngine()
+{
+    clear();
+}
+
+VortexEngine *VortexEngine::forThread(){
+    static QThreadStorage<VortexEngine *> engines;
+    if (!engines.hasLocalData())
+        engines.setLocalData(new VortexEngine);
+    return engines.localData();
+}
+
+void VortexEngine::clear(){
+    qDeleteAll(m_workspaces);
+    m_workspaces.clear();
+    m_last = 0;
+}
+
+cv::Size VortexEngine::paddedSize() const{
+    return m_last ? m_last->size : cv::Size();
+}
+
+size_t VortexEngine::workspaceBytes() const{
+    return m_last ? m_last->bytes() : 0;
+}
+
+VortexEngine::workspace *VortexEngine::getWorkspace(cv::Size size, int depth){
+    for (int i = 0; i < m_workspaces.size(); ++i){
+        if (m_workspaces[i]->size == size && m_workspaces[i]->depth == depth){
+            m_workspaces.move(i, 0);
+            return m_workspaces[0];
+        }
+    }
+    m_last = 0;
+    // drop the old buffers first so they are not alive at the same time as the new ones
+    while (m_workspaces.size() > 1)
+        delete m_workspaces.takeLast();
+    m_workspaces.prepend(new workspace(size, depth));
+    return m_workspaces[0];
+}
+
+// The gaussian filters only change with the size and the filter settings, so they are kept until the
+// setting changes.  Dragging the center filter slider only remakes the high pass table.
+template <typename T>
+const T *VortexEngine::workspace::highPassTable(double low){
+    if (low != highPassLow || highPass.empty()){
+        highPass = sharedTable(TABLE_HIGHPASS, size, depth, low);
+        highPassLow = low;
+    }
+    return highPass.ptr<T>(0);
+}
+
+template <typename T>
+const T *VortexEngine::workspace::smoothTable(double smoothing){
+    if (smoothing != smoothValue || smooth.empty()){
+        smooth = sharedTable(TABLE_SMOOTH, size, depth, smoothing);
+        smoothValue = smoothing;
+    }
+    return smooth.ptr<T>(0);
+}
+
+// Milliseconds since the last call.
+class stageClock {
+public:
+    stageClock(): m_last(cv::getTickCount()) {}
+    double lap(){
+        int64 now = cv::getTickCount();
+        double ms = 1000. * (now - m_last) / cv::getTickFrequency();
+        m_last = now;
+        return ms;
+    }
+private:
+    int64 m_last;
+};
+
+vortexTimings::vortexTimings():
+    fft(0), highPass(0), normalize(0), spiral(0), orientation(0), smooth(0), unwrap(0), quadrature(0)
+{
+}
+
+double vortexTimings::total() const{
+    return fft + highPass + normalize + spiral + orientation + smooth + unwrap + quadrature;
+}
+
+QString vortexTimings::toString() const{
+    return QString("fft %1 high pass %2 normalize %3 spiral %4 orientation %5 smooth %6 unwrap %7 quadrature %8 total %9 ms")
+            .arg(fft, 0, 'f', 1).arg(highPass, 0, 'f', 1).arg(normalize, 0, 'f', 1).arg(spiral, 0, 'f', 1)
+            .arg(orientation, 0, 'f', 1).arg(smooth, 0, 'f', 1).arg(unwrap, 0, 'f', 1).arg(quadrature, 0, 'f', 1)
+            .arg(total(), 0, 'f', 1);
+}
+
+template <typename T>
+cv::Mat VortexEngine::run(workspace &w, const cv::Mat &image, const cv::Mat &mask, const vortexParams &vp)
+{
+    typedef cv::Vec<T, 2> complexT;
+    int cols = image.cols;
+    int rows = image.rows;
+    int xsize = w.size.width;
+    int ysize = w.size.height;
+    int size = xsize*ysize;
+    // The filters are in frequency bins.  Scale them with the padding to keep the same cutoff.
+    double low = vp.low * xsize / cols;
+    double smooth = .01 * vp.smooth * xsize/2.;
+    vortexTimings &t = m_timings;
+    t = vortexTimings();
+    stageClock clock;
+
+    // convert to the working precision and pad with zeros
+    cv::Rect roi(0, 0, cols, rows);
+    if (w.size != image.size()){
+        w.input.setTo(0);
+        w.mask.setTo(0);
+    }
+    cv::Mat inputRoi = w.input(roi);
+    image.convertTo(inputRoi, w.depth);
+    cv::Mat maskRoi = w.mask(roi);
+    mask.copyTo(maskRoi);
+
+    if (vp.showInput){
+        cv::Mat xx;
+        w.input.convertTo(xx,CV_32F);
+        cv::imshow("input", xx);
+        cv::waitKey(1);
+    }
+    t.normalize += clock.lap();
+
+    // The igram is real so the transforms up to the spiral stages are real ones.  DFT_COMPLEX_OUTPUT
+    // unpacks the half spectrum they make for the complex stages.
+    cv::dft(w.input, w.fdom, DFT_COMPLEX_OUTPUT);
+    t.fft += clock.lap();
+
+    // High-pass filter the Fourier domain to remove the background.
+    complexT *fdom = w.fdom.ptr<complexT>(0);
+    if (low > 0)
+    {
+        const T *highPass = w.highPassTable<T>(low);
+        forPixels(ysize, xsize, [&](int begin, int end){
+            for (int i = begin; i < end; ++i)
+                fdom[i] *= highPass[i];
+        });
+    }
+    if (vp.showFdom){
+        cv::Mat f;
+        w.fdom.convertTo(f, numType);
+        showMag(f,true,"fdom");
+    }
+    t.highPass += clock.lap();
+
+    // Take the inverse Fourier transform to get the cleaned igram.  The filter is symmetric so it is real.
+    cv::dft(w.fdom, w.imRe, DFT_INVERSE | DFT_SCALE | DFT_REAL_OUTPUT);
+    t.fft += clock.lap();
+
+    // Normalize the image by removing the exterior and centering values.
+    T *imRe = w.imRe.ptr<T>(0);
+    const uchar *bp = w.mask.ptr<uchar>(0);
+    std::vector<double> rowSum(ysize, 0.);
+    std::vector<int> rowCount(ysize, 0);
+    cv::parallel_for_(cv::Range(0, ysize), [&](const cv::Range &r){
+        for (int y = r.start; y < r.end; ++y){
+            double sum = 0;
+            int count = 0;
+            for (int i = y * xsize; i < (y + 1) * xsize; ++i){
+                if (bp[i]){
+                    sum += imRe[i];
+                    if (imRe[i] != 0)
+                        ++count;
+                }
+                else {
+                    imRe[i] = 0;
+                }
+            }
+            rowSum[y] = sum;
+            rowCount[y] = count;
+        }
+    });
+    double sum = 0;
+    int count = 0;
+    for (int y = 0; y < ysize; ++y){
+        sum += rowSum[y];
+        count += rowCount[y];
+    }
+    t.normalize += clock.lap();
+    cv::dft(w.imRe, w.fdom, DFT_COMPLEX_OUTPUT);
+    t.fft += clock.lap();
+
+    // Calculate the intermediate values d1 and d2.  temp = fdom * spiral and fdom = fdom * spiral^2
+    // in one pass.
+    const complexT *spiral = w.spiral.ptr<complexT>(0);
+    complexT *temp = w.temp.ptr<complexT>(0);
+    forPixels(ysize, xsize, [&](int begin, int end){
+        for (int i = begin; i < end; ++i) {
+            T sRe = spiral[i][0];
+            T sIm = spiral[i][1];
+            T re = fdom[i][0]*sRe - fdom[i][1]*sIm;
+            T im = fdom[i][0]*sIm + fdom[i][1]*sRe;
+            temp[i][0] = re;
+            temp[i][1] = im;
+            fdom[i][0] = re*sRe - im*sIm;
+            fdom[i][1] = re*sIm + im*sRe;
+        }
+    });
+    t.spiral += clock.lap();
+    cv::dft(w.temp, w.d1, DFT_INVERSE | DFT_SCALE);
+    cv::dft(w.fdom, w.d2, DFT_INVERSE | DFT_SCALE);
+    t.fft += clock.lap();
+
+    // Center the cleaned igram and calculate the orientation products.
+    T m2 = (T)(sum/count);
+    const complexT *d1 = w.d1.ptr<complexT>(0);
+    const complexT *d2 = w.d2.ptr<complexT>(0);
+    complexT *r = w.r.ptr<complexT>(0);
+    forPixels(ysize, xsize, [&](int begin, int end){
+        for (int i = begin; i < end; ++i) {
+            T re = imRe[i] - m2;
+            imRe[i] = re;
+            r[i][0] = d1[i][0]*d1[i][0] - d1[i][1]*d1[i][1] - re*d2[i][0];
+            r[i][1] = d1[i][0]*d1[i][1] + d1[i][1]*d1[i][0] - re*d2[i][1];
+        }
+    });
+    t.orientation += clock.lap();
+
+    if (smooth > 0) {
+        // Low-pass filter r to smooth it.
+        cv::dft(w.r, w.temp);
+        t.fft += clock.lap();
+        const T *gauss = w.smoothTable<T>(smooth);
+        forPixels(ysize, xsize, [&](int begin, int end){
+            for (int i = begin; i < end; ++i)
+                temp[i] *= gauss[i];
+        });
+        t.smooth += clock.lap();
+        cv::dft(w.temp, w.r, DFT_INVERSE | DFT_SCALE);
+        t.fft += clock.lap();
+    }
+
+    // The orientation for unwrapping in -.5 .. .5 and its quality map.
+    double *orient = w.orient.ptr<double>(0);
+    double *qmap = w.qmap.ptr<double>(0);
+    forPixels(ysize, xsize, [&](int begin, int end){
+        for (int i = begin; i < end; ++i) {
+            double re = r[i][0];
+            double im = r[i][1];
+            orient[i] = atan2 (im, re) / (2.*M_PI);
+            qmap[i] = sqrt (re*re + im*im);
+        }
+    });
+
+    if (vp.showOrientation){
+        showData("orient", w.orient * (2.*M_PI));
+    }
+    t.orientation += clock.lap();
+
+    // Unwrap the orientation to get the direction.
+    double *dir = w.dir.ptr<double>(0);
+    qg_path_follower_vortex (w.size, orient, qmap, dir, w.path.ptr<double>(0), &w.flags[0], &w.seedStack[0], w.seeds,
+                             w.buckets, vp.unwrapper);
+    t.unwrap += clock.lap();
+
+    // Calculate the quadrature and the phase of the mirror portion.
+    cv::Mat phase = cv::Mat::zeros(rows, cols, numType);
+    T *imIm = w.imIm.ptr<T>(0);
+    cv::parallel_for_(cv::Range(0, ysize), [&](const cv::Range &range){
+        for (int y = range.start; y < range.end; ++y){
+            double *p = y < rows ? phase.ptr<double>(y) : 0;
+            for (int x = 0; x < xsize; ++x){
+                int i = y * xsize + x;
+                double d = WRAPPI(dir[i]*M_PI);
+                imIm[i] = (T)(d1[i][0]*cos(-d) - d1[i][1]*sin(-d));
+                if (p && x < cols && bp[i])
+                    p[x] = atan2 ((double)imIm[i], (double)imRe[i]);
+            }
+        }
+    });
+    t.quadrature += clock.lap();
+
+    // Display the isolated side lobe.
+    if (vp.showFdom3){
+        cv::Mat sideLobe;
+        cv::Mat planes[2] = {w.imRe, w.imIm};
+        merge(planes,2,sideLobe);
+        sideLobe.convertTo(sideLobe, numType);
+        shiftDFT(sideLobe);
+        cv::Mat fdom3;
+        dft(sideLobe,fdom3);
+        shiftDFT(fdom3);
+        showMag(fdom3, true, "fdom3");
+    }
+
+    if (vp.showWrapped){
+        cv::Mat tt = phase.clone();
+        cv::normalize(tt,tt,0.f,1.f,CV_MINMAX);
+        cv::imshow(" wrapped ", tt);
+        cv::waitKey(1);
+    }
+
+    return phase;
+}
+
+// Wrapped phase of the masked interferogram using the vortex (spiral phase quadrature) transform.
+cv::Mat VortexEngine::phase(const cv::Mat &image, const cv::Mat &mask, const vortexParams &vp)
+{
+    CV_Assert(image.channels() == 1 && mask.type() == CV_8U && mask.size() == image.size());
+    int depth = vp.singlePrecision ? CV_32F : CV_64F;
+    workspace &w = *getWorkspace(cv::Size(cv::getOptimalDFTSize(image.cols),
+                                          cv::getOptimalDFTSize(image.rows)), depth);
+    m_last = &w;
+    if (vp.singlePrecision)
+        return run<float>(w, image, mask, vp);
+    return run<double>(w, image, mask, vp);
+}
+
+cv::Mat vortexPhase(const cv::Mat &image, const cv::Mat &mask, const vortexParams &vp)
+{
+    return VortexEngine::forThread()->phase(image, mask, vp);
+}
+
+void vortexPhaseBatch(const QVector<cv::Mat> &images, const QVector<cv::Mat> &masks, const vortexParams &vp,
+                      const std::function<void (int, const cv::Mat &)> &done)
+{
+    CV_Assert(images.size() == masks.size());
+    vortexParams p = vp;
+    // opencv windows only work on the gui thread
+    p.showInput = p.showFdom = p.showOrientation = p.showFdom3 = p.showWrapped = false;
+    QVector<int> indexes(images.size());
+    for (int i = 0; i < indexes.size(); ++i)
+        indexes[i] = i;
+    QtConcurrent::blockingMap(indexes, [&](int &i){
+        cv::Mat phase;
+        try {
+            phase = vortexPhase(images[i], masks[i], p);
+        }
+        catch (std::exception &e){
+            qDebug() << "vortex failed" << i << e.what();
+        }
+        done(i, phase);
+    });
+}
+
+double wrappedPhaseRmsDifference(const cv::Mat &a, const cv::Mat &b, const cv::Mat &mask){
+    CV_Assert(a.type() == numType && b.type() == numType && a.size() == b.size());
+    double sum = 0;
+    int count = 0;
+    for (int y = 0; y < a.rows; ++y){
+        const double *pa = a.ptr<double>(y);
+        const double *pb = b.ptr<double>(y);
+        const uchar *m = mask.ptr<uchar>(y);
+        for (int x = 0; x < a.cols; ++x){
+            if (!m[x])
+                continue;
+            double d = WRAPPI(pa[x] - pb[x]);
+            sum += d * d;
+            ++count;
+        }
+    }
+    return count ? sqrt(sum/count) : 0.;
+}
@@ -18,8 +18,82 @@
 #ifndef VORTEX_H
 #define VORTEX_H
 #include <opencv2/opencv.hpp>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include "punwrap.h"
 
-void vortex(cv::Mat &dft, const char *ext,
-           double low, double smooth,
-           double *phase, const char *what);
+struct vortexParams {
+    double low;         // radius of the dft center filter
+    double smooth;      // orientation smoothing in percent of the image radius
+    bool showInput;     // debug displays
+    bool showFdom;
+    bool showOrientation;
+    bool showFdom3;
+    bool showWrapped;
+    bool singlePrecision;   // float dft and filters.  The orientation unwrap is always double.
+    unwrapMethod unwrapper; // of the orientation
+    vortexParams();
+};
+
+// milliseconds spent in each stage of the last VortexEngine::phase call
+struct vortexTimings {
+    double fft;
+    double highPass;
+    double normalize;       // padding, masking and centering
+    double spiral;
+    double orientation;
+    double smooth;
+    double unwrap;
+    double quadrature;
+    vortexTimings();
+    double total() const;
+    QString toString() const;
+};
+
+// Runs the vortex transform with workspaces that are kept between calls.  The interferogram is padded
+// with zeros to the next size cv::dft is fast at and the buffers for the last two padded sizes are kept,
+// so processing another interferogram of the same size allocates nothing but the result.  The workspace
+// also keeps the frequency tables and the filters for the last center filter and smoothing values.
+// Not thread safe.  forThread() gives each thread its own engine so everything on the gui thread (the
+// dft tab, batch processing and outline jitter) shares one.
+class VortexEngine {
+public:
+    VortexEngine();
+    ~VortexEngine();
+    static VortexEngine *forThread();
+    // image is the real masked interferogram made by prepareIgram and mask is CV_8U.
+    // Returns the wrapped phase in radians inside the mask.
+    cv::Mat phase(const cv::Mat &image, const cv::Mat &mask, const vortexParams &vp);
+    // size the last call was padded to and the bytes of workspace it used
+    cv::Size paddedSize() const;
+    size_t workspaceBytes() const;
+    const vortexTimings &timings() const { return m_timings; }
+    // frees the workspaces
+    void clear();
+
+private:
+    struct workspace;
+    workspace *getWorkspace(cv::Size size, int depth);
+    template <typename T> cv::Mat run(workspace &w, const cv::Mat &image, const cv::Mat &mask,
+                                      const vortexParams &vp);
+    QList<workspace *> m_workspaces;    // most recently used first
+    workspace *m_last;
+    vortexTimings m_timings;
+    Q_DISABLE_COPY(VortexEngine)
+};
+
+// VortexEngine::forThread()->phase()
+cv::Mat vortexPhase(const cv::Mat &image, const cv::Mat &mask, const vortexParams &vp);
+// Wrapped phases of a stack of interferograms, like the frames of one mirror to be averaged, run at
+// once on the global thread pool.  done(i, phase) is called on the pool thread as each one finishes so
+// the unwrap can start without waiting for the whole stack.  Same size images share their frequency
+// tables and each pool thread reuses its engine's workspace.  The debug displays are not shown.  phase
+// is empty when the transform failed.
+void vortexPhaseBatch(const QVector<cv::Mat> &images, const QVector<cv::Mat> &masks, const vortexParams &vp,
+                      const std::function<void (int, const cv::Mat &)> &done);
+// rms in radians of the difference of two wrapped phases inside the mask.  For checking the single
+// precision path against the double one.
+double wrappedPhaseRmsDifference(const cv::Mat &a, const cv::Mat &b, const cv::Mat &mask);
 #endif // VORTEX_H
@@ -16,14 +16,16 @@
 
 ****************************************************************************/
 #include "wavefront.h"
+#include "wavefrontresidency.h"
 
 wavefront::wavefront():
-    gaussian_diameter(0.),useSANull(true),dirtyZerns(true),regions_have_been_expanded(false)
+    gaussian_diameter(0.),useSANull(true),dirtyZerns(true),zernsPrefit(false),regions_have_been_expanded(false)
 {
 }
 
 wavefront::~wavefront()
 {
+    wavefrontResidency::get_Instance()->forget(this);
 
     data.release();
     mask.release();
@@ -53,6 +55,7 @@ wavefront::wavefront( const wavefront &wf):
     max(wf.max),
     std(wf.std),
     mean(wf.mean),
-    dirtyZerns(wf.dirtyZerns)
+    dirtyZerns(wf.dirtyZerns),
+    zernsPrefit(false)
 {}
 
@@ -52,6 +52,7 @@ public:
     double std;
     double mean;
     bool dirtyZerns;
+    bool zernsPrefit;   // InputZerns were already fit by the wave front loader
     QVector<std::vector<cv::Point> > regions;
     bool regions_have_been_expanded;
 
@@ -0,0 +1,440 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#include "wavefrontcatalog.h"
+#include "surfacemanager.h"
+#include "wavefrontfile.h"
+#include "zernikeprocess.h"
+#include "mirrordlg.h"
+#include "settings2.h"
+#include "surfaceanalysistools.h"
+#include "utils.h"
+#include <QtConcurrent>
+#include <QCryptographicHash>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QStandardPaths>
+#include <QSettings>
+#include <QDebug>
+#include <algorithm>
+
+#define CATALOG_VERSION 1
+
+wavefrontCatalogEntry::wavefrontCatalogEntry():
+    size(0), modified(0), width(0), height(0), diameter(0), roc(0), lambda(0),
+    isEllipse(false), nulled(false), rmsNm(0), pvNm(0)
+{
+}
+
+double wavefrontCatalogEntry::rms() const{
+    return rmsNm/outputLambda;
+}
+
+double wavefrontCatalogEntry::pv() const{
+    return pvNm/outputLambda;
+}
+
+double wavefrontCatalogEntry::astig() const{
+    if (zernikes.size() < 6)
+        return 0;
+    return sqrt(zernikes[4] * zernikes[4] + zernikes[5] * zernikes[5]) * lambda/outputLambda;
+}
+
+// same as the metrics display
+double wavefrontCatalogEntry::strehl() const{
+    double st = 2. * M_PI * rms();
+    return exp(-st * st);
+}
+
+QJsonObject wavefrontCatalogEntry::toJson() const{
+    QJsonObject obj;
+    obj["file"] = fileName;
+    obj["size"] = double(size);
+    obj["modified"] = double(modified);
+    obj["sha1"] = sha1;
+    obj["width"] = width;
+    obj["height"] = height;
+    obj["diameter"] = diameter;
+    obj["roc"] = roc;
+    obj["lambda"] = lambda;
+    obj["ellipse"] = isEllipse;
+    obj["nulled"] = nulled;
+    QJsonArray z;
+    for (std::size_t i = 0; i < zernikes.size(); ++i)
+        z.append(zernikes[i]);
+    obj["zernikes"] = z;
+    obj["rmsNm"] = rmsNm;
+    obj["pvNm"] = pvNm;
+    obj["metricsKey"] = metricsKey;
+    return obj;
+}
+
+wavefrontCatalogEntry wavefrontCatalogEntry::fromJson(const QJsonObject &obj){
+    wavefrontCatalogEntry e;
+    e.fileName = obj["file"].toString();
+    e.size = qint64(obj["size"].toDouble());
+    e.modified = qint64(obj["modified"].toDouble());
+    e.sha1 = obj["sha1"].toString();
+    e.width = obj["width"].toInt();
+    e.height = obj["height"].toInt();
+    e.diameter = obj["diameter"].toDouble();
+    e.roc = obj["roc"].toDouble();
+    e.lambda = obj["lambda"].toDouble();
+    e.isEllipse = obj["ellipse"].toBool();
+    e.nulled = obj["nulled"].toBool();
+    QJsonArray z = obj["zernikes"].toArray();
+    for (int i = 0; i < z.size(); ++i)
+        e.zernikes.push_back(z[i].toDouble());
+    e.rmsNm = obj["rmsNm"].toDouble();
+    e.pvNm = obj["pvNm"].toDouble();
+    e.metricsKey = obj["metricsKey"].toString();
+    return e;
+}
+
+wavefrontCatalogQuery::wavefrontCatalogQuery():
+    maxRms(0), minStrehl(0), maxAstig(0), diameter(0), roc(0), tolerance(1)
+{
+}
+
+static bool within(double v, double target, double percent){
+    return fabs(v - target) <= fabs(target) * percent * .01;
+}
+
+bool wavefrontCatalogQuery::matches(const wavefrontCatalogEntry &e) const{
+    if (!nameContains.isEmpty() && !e.fileName.contains(nameContains, Qt::CaseInsensitive))
+        return false;
+    if (maxRms > 0 && e.rms() > maxRms)
+        return false;
+    if (minStrehl > 0 && e.strehl() < minStrehl)
+        return false;
+    if (maxAstig > 0 && e.astig() > maxAstig)
+        return false;
+    if (diameter > 0 && !within(e.diameter, diameter, tolerance))
+        return false;
+    if (roc > 0 && !within(e.roc, roc, tolerance))
+        return false;
+    return true;
+}
+
+wavefrontCatalog *wavefrontCatalog::get_Instance(){
+    static wavefrontCatalog *instance = new wavefrontCatalog();
+    return instance;
+}
+
+wavefrontCatalog::wavefrontCatalog(QObject *parent) :
+    QObject(parent), m_canceled(false)
+{
+    QSettings set;
+    QString defaultName = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+            "/wavefrontCatalog.json";
+    m_fileName = set.value("wavefrontCatalogFile", defaultName).toString();
+    load();
+}
+
+QString wavefrontCatalog::fileName() const{
+    return m_fileName;
+}
+
+void wavefrontCatalog::setFileName(const QString &fileName){
+    m_fileName = fileName;
+    QSettings set;
+    set.setValue("wavefrontCatalogFile", fileName);
+    load();
+}
+
+int wavefrontCatalog::size() const{
+    return m_entries.size();
+}
+
+QStringList wavefrontCatalog::directories() const{
+    return m_directories;
+}
+
+void wavefrontCatalog::cancel(){
+    m_canceled = true;
+}
+
+bool wavefrontCatalog::load(){
+    m_entries.clear();
+    m_directories.clear();
+    QFile file(m_fileName);
+    if (!file.exists())
+        return true;
+    if (!file.open(QIODevice::ReadOnly)){
+        qDebug() << "Can not open wavefront catalog" << m_fileName;
+        return false;
+    }
+    QJsonParseError err;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &err);
+    if (doc.isNull()){
+        qDebug() << "Bad wavefront catalog" << m_fileName << err.errorString();
+        return false;
+    }
+    QJsonObject root = doc.object();
+    QJsonArray dirs = root["directories"].toArray();
+    for (int i = 0; i < dirs.size(); ++i)
+        m_directories << dirs[i].toString();
+    QJsonArray entries = root["entries"].toArray();
+    for (int i = 0; i < entries.size(); ++i){
+        wavefrontCatalogEntry e = wavefrontCatalogEntry::fromJson(entries[i].toObject());
+        m_entries.insert(e.fileName, e);
+    }
+    return true;
+}
+
+bool wavefrontCatalog::save(){
+    QJsonObject root;
+    root["version"] = CATALOG_VERSION;
+    root["directories"] = QJsonArray::fromStringList(m_directories);
+    QJsonArray entries;
+    foreach(const wavefrontCatalogEntry &e, m_entries)
+        entries.append(e.toJson());
+    root["entries"] = entries;
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)){
+        qDebug() << "Can not write wavefront catalog" << m_fileName;
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+int wavefrontCatalog::indexDirectory(const QString &dir, SurfaceManager *sm){
+    QString path = QDir(dir).absolutePath();
+    if (!m_directories.contains(path))
+        m_directories << path;
+    QStringList files;
+    QDirIterator it(path, QStringList() << "*.wft" << "*.wftb", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+        files << it.next();
+    files.sort();
+    return indexFiles(files, sm);
+}
+
+int wavefrontCatalog::removeMissing(){
+    QStringList gone;
+    foreach(const QString &name, m_entries.keys()){
+        if (!QFileInfo::exists(name))
+            gone << name;
+    }
+    foreach(const QString &name, gone)
+        m_entries.remove(name);
+    if (gone.size())
+        save();
+    return gone.size();
+}
+
+QList<wavefrontCatalogEntry> wavefrontCatalog::query(const wavefrontCatalogQuery &q) const{
+    QList<wavefrontCatalogEntry> result;
+    foreach(const wavefrontCatalogEntry &e, m_entries){
+        if (q.matches(e))
+            result << e;
+    }
+    std::sort(result.begin(), result.end(), [](const wavefrontCatalogEntry &a, const wavefrontCatalogEntry &b){
+        return a.fileName < b.fileName;
+    });
+    return result;
+}
+
+QString wavefrontCatalog::currentMetricsKey(){
+    mirrorDlg *md = mirrorDlg::get_Instance();
+    surfaceAnalysisTools *saTools = surfaceAnalysisTools::get_Instance();
+    double scz8 = md->doNull ? md->z8 * md->cc : 0.;
+    double defocus = saTools->m_useDefocus ? saTools->m_defocus : 0.;
+    QString enables;
+    for (std::size_t i = 0; i < zernEnables.size(); ++i)
+        enables += zernEnables[i] ? '1' : '0';
+    return QString("%1 %2 %3 %4 %5").arg(scz8, 0, 'g', 10).arg(defocus, 0, 'g', 10)
+            .arg(md->m_useAnnular).arg(md->isEllipse()).arg(enables);
+}
+
+namespace {
+struct indexItem {
+    QString fileName;
+    wavefrontCatalogEntry entry;
+    wavefront *wf;
+    bool unchanged;     // same contents as the catalog entry only the time changed
+    bool fitDone;
+    QString error;
+    indexItem():wf(0), unchanged(false), fitDone(false){}
+};
+}
+
+static QString hashFile(const QString &fileName){
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    return QString(hash.result().toHex());
+}
+
+// Files are done a batch at a time so only a few wave fronts are in memory.  Reading, the mask and the
+// zernike fit are done on the thread pool.  Annular fits and the nulling use state in zernikeProcess
+// so they are done here on the gui thread.
+int wavefrontCatalog::indexFiles(const QStringList &files, SurfaceManager *sm){
+    m_canceled = false;
+    QString metricsKey = currentMetricsKey();
+    QStringList todo;
+    foreach(const QString &name, files){
+        QFileInfo info(name);
+        QString path = info.absoluteFilePath();
+        if (m_entries.contains(path)){
+            const wavefrontCatalogEntry &e = m_entries[path];
+            if (e.size == info.size() && e.modified == info.lastModified().toMSecsSinceEpoch() &&
+                    e.metricsKey == metricsKey)
+                continue;
+        }
+        todo << path;
+    }
+
+    emit progressRange(0, todo.size());
+    emit status(0);
+    if (todo.isEmpty())
+        return 0;
+
+    mirrorDlg *md = mirrorDlg::get_Instance();
+    zernikeProcess *zp = zernikeProcess::get_Instance();
+    bool downSize = Settings2::getInstance()->m_general->shouldDownsize();
+    bool annular = md->m_useAnnular;
+    bool ellipseConfig = md->isEllipse();
+    const QHash<QString, wavefrontCatalogEntry> &entries = m_entries;
+    const wavefrontFileInfo defaults = SurfaceManager::defaultFileInfo();
+
+    int batchSize = qMax(2, QThread::idealThreadCount()) * 2;
+    int done = 0;
+    int updated = 0;
+    for (int start = 0; start < todo.size() && !m_canceled; start += batchSize){
+        QVector<indexItem> items;
+        for (int i = start; i < qMin(start + batchSize, todo.size()); ++i){
+            indexItem item;
+            item.fileName = todo[i];
+            items << item;
+        }
+        emit currentFile(items.front().fileName);
+
+        QFutureWatcher<void> watcher;
+        QEventLoop loop;
+        connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+        watcher.setFuture(QtConcurrent::map(items,
+                          [sm, zp, &entries, &metricsKey, &defaults, downSize, annular, ellipseConfig](indexItem &item){
+            QFileInfo fi(item.fileName);
+            wavefrontCatalogEntry &e = item.entry;
+            e.fileName = item.fileName;
+            e.size = fi.size();
+            e.modified = fi.lastModified().toMSecsSinceEpoch();
+            e.sha1 = hashFile(item.fileName);
+            if (e.sha1.isEmpty()){
+                item.error = "Can not read " + item.fileName;
+                return;
+            }
+            if (entries.contains(item.fileName) && entries[item.fileName].sha1 == e.sha1 &&
+                    entries[item.fileName].metricsKey == metricsKey){
+                qint64 modified = e.modified;
+                e = entries[item.fileName];
+                e.modified = modified;
+                item.unchanged = true;
+                return;
+            }
+            try {
+                wavefrontFileInfo info = defaults;
+                wavefront *wf = SurfaceManager::readWaveFrontFile(item.fileName, info, item.error);
+                if (!wf)
+                    return;
+                e.width = info.width;
+                e.height = info.height;
+                e.diameter = info.diameter;
+                e.roc = info.roc;
+                e.lambda = info.lambda;
+                e.isEllipse = info.isEllipse;
+                e.nulled = info.nulled;
+
+                // the outlines as applyWaveFrontFileInfo makes them without changing the mirror config
+                double rado = info.insideRadius;
+                wf->m_outside = CircleOutline(QPointF(info.outsideX, info.outsideY), info.outsideRadius);
+                if (info.isEllipse || ellipseConfig)
+                    wf->m_outside = CircleOutline(QPointF(info.outsideX, info.outsideY), info.outsideX - 2);
+                if (rado == 0)
+                    wf->m_inside = CircleOutline(QPointF(info.outsideX, info.outsideY), 0);
+                else
+                    wf->m_inside = CircleOutline(QPointF(info.insideX, info.insideY), rado);
+                wf->diameter = info.diameter;
+                wf->roc = info.roc;
+                wf->lambda = info.lambda;
+                wf->useSANull = !info.nulled;
+                wf->name = item.fileName;
+
+                if (downSize)
+                    sm->downSizeWf(wf);
+                sm->buildMask(wf);
+                if (!annular && !info.isEllipse && !ellipseConfig)
+                    item.fitDone = zp->unwrap_to_zernikes(*wf);     // else fit again on the gui thread
+                item.wf = wf;
+            }
+            catch (const std::bad_alloc &){
+                item.error = "Out of memory reading " + item.fileName;
+            }
+        }));
+        if (!watcher.isFinished())
+            loop.exec();
+        watcher.waitForFinished();
+
+        for (int i = 0; i < items.size(); ++i){
+            indexItem &item = items[i];
+            emit status(++done);
+            if (!item.error.isEmpty())
+                qDebug() << "catalog:" << item.error;
+            if (item.unchanged){
+                m_entries.insert(item.fileName, item.entry);
+                continue;
+            }
+            if (!item.wf)
+                continue;
+            wavefront *wf = item.wf;
+            wavefrontCatalogEntry &e = item.entry;
+            cv::Mat surface;
+            if (e.isEllipse || ellipseConfig){
+                surface = wf->data;
+            }
+            else {
+                if (!item.fitDone)
+                    zp->unwrap_to_zernikes(*wf);
+                e.zernikes = wf->InputZerns;
+                surface = zp->null_unwrapped(*wf, wf->InputZerns, zernEnables, 0, Z_TERMS);
+            }
+            cv::Scalar mean,std;
+            cv::meanStdDev(surface, mean, std, wf->workMask);
+            double mmin, mmax;
+            minMaxIdx(surface, &mmin, &mmax, 0, 0, wf->workMask);
+            e.rmsNm = std.val[0] * e.lambda;
+            e.pvNm = (mmax - mmin) * e.lambda;
+            e.metricsKey = metricsKey;
+            m_entries.insert(item.fileName, e);
+            ++updated;
+            delete wf;
+            item.wf = 0;
+            QApplication::processEvents();
+        }
+    }
+    save();
+    return updated;
+}
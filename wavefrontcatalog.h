@@ -0,0 +1,111 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#ifndef WAVEFRONTCATALOG_H
+#define WAVEFRONTCATALOG_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QJsonObject>
+#include <vector>
+
+class SurfaceManager;
+
+// What the catalog knows about one wave front file.  Enough to search an archive without
+// reading the pixels again.
+struct wavefrontCatalogEntry {
+    QString fileName;
+    qint64 size;
+    qint64 modified;        // ms since epoch
+    QString sha1;
+    int width;
+    int height;
+    double diameter;
+    double roc;
+    double lambda;          // nm
+    bool isEllipse;
+    bool nulled;
+    std::vector<double> zernikes;   // waves at lambda
+    double rmsNm;           // of the surface after the disabled zernike terms are removed
+    double pvNm;
+    QString metricsKey;     // the null, defocus and zernike enables rmsNm and pvNm were computed with
+    wavefrontCatalogEntry();
+    // in waves of the output lambda
+    double rms() const;
+    double pv() const;
+    double astig() const;
+    double strehl() const;
+    QJsonObject toJson() const;
+    static wavefrontCatalogEntry fromJson(const QJsonObject &obj);
+};
+
+// Any value left at zero is not used to filter.
+struct wavefrontCatalogQuery {
+    QString nameContains;
+    double maxRms;
+    double minStrehl;
+    double maxAstig;
+    double diameter;
+    double roc;
+    double tolerance;       // percent used for diameter and roc
+    wavefrontCatalogQuery();
+    bool matches(const wavefrontCatalogEntry &e) const;
+};
+
+// Index of wave front files kept in a json file.  Indexing reads each new or changed file once,
+// fits the zernikes and records the metrics.  Files whose size and time have not changed are skipped
+// unless their metrics were computed with a different null or zernike enables.
+class wavefrontCatalog : public QObject
+{
+    Q_OBJECT
+public:
+    static wavefrontCatalog *get_Instance();
+    QString fileName() const;
+    void setFileName(const QString &fileName);
+    bool load();
+    bool save();
+    int size() const;
+    // Indexes all the .wft and .wftb files in dir and its sub directories and remembers dir so
+    // it can be updated later.  Returns the number of files that were added or updated.
+    int indexDirectory(const QString &dir, SurfaceManager *sm);
+    int indexFiles(const QStringList &files, SurfaceManager *sm);
+    int removeMissing();
+    QList<wavefrontCatalogEntry> query(const wavefrontCatalogQuery &q) const;
+    // Identifies the settings the rms and pv depend on.  Entries made with other settings are
+    // indexed again.
+    static QString currentMetricsKey();
+    QStringList directories() const;
+
+signals:
+    void progressRange(int,int);
+    void status(int);
+    void currentFile(QString);
+
+public slots:
+    void cancel();
+
+private:
+    explicit wavefrontCatalog(QObject *parent = 0);
+    QString m_fileName;
+    QHash<QString, wavefrontCatalogEntry> m_entries;
+    QStringList m_directories;
+    bool m_canceled;
+};
+
+#endif // WAVEFRONTCATALOG_H
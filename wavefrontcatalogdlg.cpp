@@ -0,0 +1,169 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#include "wavefrontcatalogdlg.h"
+#include "ui_wavefrontcatalogdlg.h"
+#include "wavefrontcatalog.h"
+#include "wavefrontloader.h"
+#include "surfacemanager.h"
+#include "mirrordlg.h"
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QSettings>
+#include <algorithm>
+
+wavefrontCatalogDlg::wavefrontCatalogDlg(SurfaceManager *sm, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::wavefrontCatalogDlg), m_sm(sm)
+{
+    ui->setupUi(this);
+    mirrorDlg *md = mirrorDlg::get_Instance();
+    ui->diameter->setValue(md->diameter);
+    ui->roc->setValue(md->roc);
+    ui->results->setColumnCount(7);
+    ui->results->setHorizontalHeaderLabels(QStringList() << "File" << "Diameter" << "ROC" << "RMS"
+                                           << "Strehl" << "Astig" << "Modified");
+    ui->results->setSelectionBehavior(QAbstractItemView::SelectRows);
+    ui->results->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    showCatalogInfo();
+}
+
+wavefrontCatalogDlg::~wavefrontCatalogDlg()
+{
+    delete ui;
+}
+
+void wavefrontCatalogDlg::showCatalogInfo(){
+    wavefrontCatalog *cat = wavefrontCatalog::get_Instance();
+    ui->catalogInfo->setText(QString("%1  (%2 wavefronts)").arg(cat->fileName()).arg(cat->size()));
+}
+
+void wavefrontCatalogDlg::index(const QStringList &dirs){
+    wavefrontCatalog *cat = wavefrontCatalog::get_Instance();
+    QProgressDialog pd("Indexing wavefronts", "Cancel", 0, 100, this);
+    pd.setWindowModality(Qt::WindowModal);
+    connect(&pd, SIGNAL(canceled()), cat, SLOT(cancel()));
+    connect(cat, SIGNAL(progressRange(int,int)), &pd, SLOT(setRange(int,int)));
+    connect(cat, SIGNAL(status(int)), &pd, SLOT(setValue(int)));
+    connect(cat, SIGNAL(currentFile(QString)), &pd, SLOT(setLabelText(QString)));
+    pd.show();
+    int count = 0;
+    foreach(const QString &dir, dirs){
+        count += cat->indexDirectory(dir, m_sm);
+        if (pd.wasCanceled())
+            break;
+    }
+    disconnect(cat, 0, &pd, 0);
+    pd.hide();
+    showCatalogInfo();
+    QMessageBox::information(this, "Wavefront catalog", QString("%1 wavefronts added or updated.").arg(count));
+}
+
+void wavefrontCatalogDlg::on_addDirectory_clicked(){
+    QSettings settings;
+    QString lastPath = settings.value("lastPath","").toString();
+    QString dir = QFileDialog::getExistingDirectory(this, "Directory of wavefronts to add to the catalog", lastPath);
+    if (dir.isEmpty())
+        return;
+    index(QStringList() << dir);
+}
+
+void wavefrontCatalogDlg::on_updateCatalog_clicked(){
+    index(wavefrontCatalog::get_Instance()->directories());
+}
+
+void wavefrontCatalogDlg::on_removeMissing_clicked(){
+    int count = wavefrontCatalog::get_Instance()->removeMissing();
+    showCatalogInfo();
+    QMessageBox::information(this, "Wavefront catalog", QString("%1 missing files removed.").arg(count));
+}
+
+void wavefrontCatalogDlg::on_catalogFile_clicked(){
+    wavefrontCatalog *cat = wavefrontCatalog::get_Instance();
+    QString fileName = QFileDialog::getSaveFileName(this, "Catalog file", cat->fileName(),
+                                                    "Wavefront catalog (*.json)", 0,
+                                                    QFileDialog::DontConfirmOverwrite);
+    if (fileName.isEmpty())
+        return;
+    cat->setFileName(fileName);
+    showCatalogInfo();
+}
+
+void wavefrontCatalogDlg::on_search_clicked(){
+    wavefrontCatalogQuery q;
+    q.nameContains = ui->nameContains->text();
+    q.maxRms = ui->maxRms->value();
+    q.minStrehl = ui->minStrehl->value();
+    q.maxAstig = ui->maxAstig->value();
+    if (ui->matchMirror->isChecked()){
+        q.diameter = ui->diameter->value();
+        q.roc = ui->roc->value();
+        q.tolerance = ui->tolerance->value();
+    }
+    QList<wavefrontCatalogEntry> found = wavefrontCatalog::get_Instance()->query(q);
+
+    m_results.clear();
+    QString metricsKey = wavefrontCatalog::currentMetricsKey();
+    int stale = 0;
+    ui->results->setRowCount(found.size());
+    for (int row = 0; row < found.size(); ++row){
+        const wavefrontCatalogEntry &e = found[row];
+        if (e.metricsKey != metricsKey)
+            ++stale;
+        m_results << e.fileName;
+        QTableWidgetItem *name = new QTableWidgetItem(QFileInfo(e.fileName).fileName());
+        name->setToolTip(e.fileName);
+        ui->results->setItem(row, 0, name);
+        ui->results->setItem(row, 1, new QTableWidgetItem(QString::number(e.diameter, 'f', 1)));
+        ui->results->setItem(row, 2, new QTableWidgetItem(QString::number(e.roc, 'f', 1)));
+        ui->results->setItem(row, 3, new QTableWidgetItem(QString::number(e.rms(), 'f', 3)));
+        ui->results->setItem(row, 4, new QTableWidgetItem(QString::number(e.strehl(), 'f', 3)));
+        ui->results->setItem(row, 5, new QTableWidgetItem(QString::number(e.astig(), 'f', 3)));
+        ui->results->setItem(row, 6, new QTableWidgetItem(
+                                 QDateTime::fromMSecsSinceEpoch(e.modified).toString("yyyy-MM-dd hh:mm")));
+    }
+    ui->results->resizeColumnsToContents();
+    QString matches = QString("%1 matches").arg(found.size());
+    if (stale)
+        matches += QString(", %1 with RMS from other null or zernike settings. Update the catalog.").arg(stale);
+    ui->matches->setText(matches);
+}
+
+void wavefrontCatalogDlg::load(const QStringList &files){
+    if (files.isEmpty())
+        return;
+    waveFrontLoader loader;
+    loader.loadx(files, m_sm);
+}
+
+void wavefrontCatalogDlg::on_loadSelected_clicked(){
+    QList<int> rows;
+    foreach(const QModelIndex &ndx, ui->results->selectionModel()->selectedRows())
+        rows << ndx.row();
+    std::sort(rows.begin(), rows.end());
+    QStringList files;
+    foreach(int row, rows)
+        files << m_results[row];
+    load(files);
+}
+
+void wavefrontCatalogDlg::on_loadAll_clicked(){
+    load(m_results);
+}
@@ -0,0 +1,56 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#ifndef WAVEFRONTCATALOGDLG_H
+#define WAVEFRONTCATALOGDLG_H
+
+#include <QDialog>
+#include <QStringList>
+
+class SurfaceManager;
+
+namespace Ui {
+class wavefrontCatalogDlg;
+}
+
+class wavefrontCatalogDlg : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit wavefrontCatalogDlg(SurfaceManager *sm, QWidget *parent = 0);
+    ~wavefrontCatalogDlg();
+
+private slots:
+    void on_addDirectory_clicked();
+    void on_updateCatalog_clicked();
+    void on_removeMissing_clicked();
+    void on_catalogFile_clicked();
+    void on_search_clicked();
+    void on_loadSelected_clicked();
+    void on_loadAll_clicked();
+
+private:
+    void index(const QStringList &dirs);
+    void showCatalogInfo();
+    void load(const QStringList &files);
+    Ui::wavefrontCatalogDlg *ui;
+    SurfaceManager *m_sm;
+    QStringList m_results;
+};
+
+#endif // WAVEFRONTCATALOGDLG_H
@@ -0,0 +1,400 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#include "wavefrontfile.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QDebug>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <locale>
+
+static_assert(sizeof(wftbHeader) == 256, "wftb header must stay 256 bytes");
+static_assert(sizeof(wftbHeader) % WFTB_DATA_ALIGNMENT == 0, "wftb pixel block must stay aligned");
+
+wavefrontFileInfo::wavefrontFileInfo():
+    width(0), height(0), outsideX(0.), outsideY(0.), outsideRadius(0.),
+    insideX(0.), insideY(0.), insideRadius(0.), diameter(0.), roc(0.), lambda(0.),
+    isEllipse(false), ellipseVerticalAxis(0.), nulled(false)
+{
+}
+
+static bool readHeader(QFile &file, wftbHeader &header){
+    if (file.read((char *)&header, sizeof(header)) != (qint64)sizeof(header))
+        return false;
+    if (memcmp(header.magic, WFTB_MAGIC, sizeof(WFTB_MAGIC)) != 0)
+        return false;
+    if (header.version > WFTB_VERSION){
+        qDebug() << "wftb version" << header.version << "is newer than this program supports";
+        return false;
+    }
+    if (header.byteOrderMark != WFTB_BYTE_ORDER_MARK){
+        qDebug() << "wftb file was written on a machine with a different byte order";
+        return false;
+    }
+    if (header.cols <= 0 || header.rows <= 0 || header.headerSize < sizeof(header))
+        return false;
+    if (header.dataBytes != (quint64)header.cols * header.rows * sizeof(double))
+        return false;
+    if ((quint64)file.size() < header.headerSize + header.dataBytes)
+        return false;
+    return true;
+}
+
+static void headerToInfo(const wftbHeader &header, wavefrontFileInfo &info){
+    info.width = header.cols;
+    info.height = header.rows;
+    info.outsideX = header.outsideX;
+    info.outsideY = header.outsideY;
+    info.outsideRadius = header.outsideRadius;
+    info.insideX = header.insideX;
+    info.insideY = header.insideY;
+    info.insideRadius = (header.flags & WFTB_OBSTRUCTION) ? header.insideRadius : 0.;
+    info.diameter = header.diameter;
+    info.roc = header.roc;
+    info.lambda = header.lambda;
+    info.isEllipse = (header.flags & WFTB_ELLIPSE) != 0;
+    info.ellipseVerticalAxis = header.ellipseVerticalAxis;
+    info.nulled = (header.flags & WFTB_NULLED) != 0;
+}
+
+bool isBinaryWavefrontFile(const QString &fileName){
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return fileName.endsWith(".wftb", Qt::CaseInsensitive);
+    char magic[sizeof(WFTB_MAGIC)];
+    if (file.read(magic, sizeof(magic)) != (qint64)sizeof(magic))
+        return false;
+    return memcmp(magic, WFTB_MAGIC, sizeof(magic)) == 0;
+}
+
+bool readBinaryWavefrontHeader(const QString &fileName, wavefrontFileInfo &info){
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    wftbHeader header;
+    if (!readHeader(file, header))
+        return false;
+    headerToInfo(header, info);
+    return true;
+}
+
+bool readBinaryWavefront(const QString &fileName, cv::Mat_<double> &data, wavefrontFileInfo &info){
+    QFile file(fileName);
+    wftbHeader header;
+    if (!file.open(QIODevice::ReadOnly) || !readHeader(file, header))
+        return false;
+    headerToInfo(header, info);
+
+    // Read into memory the wave front owns rather than mapping the file.  The mask and zernike fit touch
+    // every pixel right after loading anyway and a mapping would keep the file busy so it could not be
+    // saved over.
+    cv::Mat_<double> m(header.rows, header.cols);
+    if (!file.seek(header.headerSize) ||
+            file.read((char *)m.data, header.dataBytes) != (qint64)header.dataBytes)
+        return false;
+    data = m;
+    return true;
+}
+
+bool writeBinaryWavefront(const QString &fileName, const cv::Mat_<double> &data, const wavefrontFileInfo &info){
+    // written to a temporary file that replaces fileName on commit so a failed save leaves the old file
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    wftbHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, WFTB_MAGIC, sizeof(WFTB_MAGIC));
+    header.version = WFTB_VERSION;
+    header.headerSize = sizeof(header);
+    header.byteOrderMark = WFTB_BYTE_ORDER_MARK;
+    header.cols = data.cols;
+    header.rows = data.rows;
+    header.flags = (info.nulled ? WFTB_NULLED : 0) |
+                   (info.isEllipse ? WFTB_ELLIPSE : 0) |
+                   (info.insideRadius > 0 ? WFTB_OBSTRUCTION : 0);
+    header.outsideX = info.outsideX;
+    header.outsideY = info.outsideY;
+    header.outsideRadius = info.outsideRadius;
+    header.insideX = info.insideX;
+    header.insideY = info.insideY;
+    header.insideRadius = info.insideRadius;
+    header.diameter = info.diameter;
+    header.roc = info.roc;
+    header.lambda = info.lambda;
+    header.ellipseVerticalAxis = info.ellipseVerticalAxis;
+    header.dataBytes = (quint64)data.cols * data.rows * sizeof(double);
+
+    if (file.write((const char *)&header, sizeof(header)) != (qint64)sizeof(header))
+        return false;
+
+    const qint64 rowBytes = data.cols * sizeof(double);
+    if (data.isContinuous()){
+        if (file.write((const char *)data.data, header.dataBytes) != (qint64)header.dataBytes)
+            return false;
+    }
+    else {
+        for (int row = 0; row < data.rows; ++row){
+            if (file.write((const char *)data.ptr(row), rowBytes) != rowBytes)
+                return false;
+        }
+    }
+    return file.commit();
+}
+
+static bool writeAsciiWavefront(const wavefrontSaveJob &job){
+    std::ofstream file((job.fileName.toStdString().c_str()));
+    if (!file.is_open())
+        return false;
+    const cv::Mat_<double> &data = job.data;
+    const wavefrontFileInfo &info = job.info;
+    file << data.cols << std::endl << data.rows << std::endl;
+    for (int row = data.rows - 1; row >=0; --row){
+        for (int col = 0; col < data.cols ; ++col){
+            file << data(row,col) << '\n';
+        }
+    }
+    file << "outside ellipse " << info.outsideX
+         << " " << info.outsideY
+         << " " << info.outsideRadius
+         << " "  << job.outsideRadius << std:: endl;
+
+    if (job.insideRadius > 0){
+        file << "obstruction ellipse " << info.insideX
+         << " " << info.insideY
+         << " " << info.insideRadius
+         << " " << job.insideRadius << std:: endl;
+    }
+
+    file << "DIAM " << info.diameter << std::endl;
+    file << "ROC " << info.roc << std::endl;
+    file << "Lambda " << info.lambda << std::endl;
+    if (info.isEllipse){
+        file << "ellipse_vertical_axis " << info.ellipseVerticalAxis;
+    }
+    file.close();
+    return !file.fail();
+}
+
+bool writeWavefrontFile(const wavefrontSaveJob &job){
+    if (job.fileName.endsWith(".wftb", Qt::CaseInsensitive))
+        return writeBinaryWavefront(job.fileName, job.data, job.info);
+    return writeAsciiWavefront(job);
+}
+
+// exact powers of ten a double can hold.
+static const double s_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline void skipSpace(const char *&p, const char *end){
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+        ++p;
+}
+
+// Parse the number at p and move p past it.  Numbers with up to 19 significant digits and
+// an exponent within +-22 are converted exactly with one multiply or divide.  Anything else
+// falls back to the C++ stream conversion in the "C" locale.  strtod can't be used because
+// it follows the locale Qt sets at startup and from_chars needs C++17.
+static bool parseNumber(const char *&p, const char *end, double &v){
+    const char *start = p;
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')){
+        neg = (*p == '-');
+        ++p;
+    }
+    quint64 mantissa = 0;
+    int digits = 0;
+    int exp10 = 0;
+    bool any = false;
+    bool truncated = false;
+    while (p < end && *p >= '0' && *p <= '9'){
+        any = true;
+        if (digits < 19){
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0)
+                ++digits;
+        }
+        else {
+            ++exp10;
+            truncated = true;
+        }
+        ++p;
+    }
+    if (p < end && *p == '.'){
+        ++p;
+        while (p < end && *p >= '0' && *p <= '9'){
+            any = true;
+            if (digits < 19){
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0)
+                    ++digits;
+                --exp10;
+            }
+            else
+                truncated = true;
+            ++p;
+        }
+    }
+    if (!any){
+        p = start;
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')){
+        const char *e = p + 1;
+        bool negExp = false;
+        if (e < end && (*e == '-' || *e == '+')){
+            negExp = (*e == '-');
+            ++e;
+        }
+        if (e < end && *e >= '0' && *e <= '9'){
+            int ev = 0;
+            while (e < end && *e >= '0' && *e <= '9'){
+                if (ev < 10000)
+                    ev = ev * 10 + (*e - '0');
+                ++e;
+            }
+            exp10 += negExp ? -ev : ev;
+            p = e;
+        }
+    }
+
+    if (!truncated && mantissa <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22){
+        double d = (double)mantissa;
+        v = (exp10 < 0) ? d / s_pow10[-exp10] : d * s_pow10[exp10];
+    }
+    else {
+        std::istringstream iss(std::string(start, p - start));
+        iss.imbue(std::locale::classic());
+        iss >> v;
+        return true;
+    }
+    if (neg)
+        v = -v;
+    return true;
+}
+
+static double tokenValue(const QList<QByteArray> &tokens, int i){
+    double v = 0.;
+    if (i < tokens.size()){
+        const char *p = tokens[i].constData();
+        parseNumber(p, p + tokens[i].size(), v);
+    }
+    return v;
+}
+
+bool readAsciiWavefront(const QString &fileName, cv::Mat_<double> &data, wavefrontFileInfo &info){
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    // map the whole file when possible otherwise read it in one go.
+    QByteArray buffer;
+    const char *p;
+    const char *end;
+    uchar *mapped = (file.size() > 0) ? file.map(0, file.size()) : 0;
+    if (mapped){
+        p = (const char *)mapped;
+        end = p + file.size();
+    }
+    else {
+        buffer = file.readAll();
+        p = buffer.constData();
+        end = p + buffer.size();
+    }
+
+    double width = 0;
+    double height = 0;
+    skipSpace(p, end);
+    if (!parseNumber(p, end, width))
+        return false;
+    skipSpace(p, end);
+    if (!parseNumber(p, end, height))
+        return false;
+    if (width < 1 || height < 1)
+        return false;
+    int cols = width;
+    int rows = height;
+
+    // rows are stored bottom up.  A short file leaves the rest zero as the stream reader did.
+    data = cv::Mat_<double>::zeros(rows, cols);
+    bool shortFile = false;
+    for (int y = 0; y < rows && !shortFile; ++y){
+        double *row = data[rows - y - 1];
+        for (int x = 0; x < cols; ++x){
+            skipSpace(p, end);
+            if (!parseNumber(p, end, row[x])){
+                shortFile = true;
+                break;
+            }
+        }
+    }
+    if (shortFile)
+        qDebug() << "wft file is short" << fileName;
+
+    info.width = cols;
+    info.height = rows;
+    info.outsideX = (width-1)/2.;
+    info.outsideY = (height-1)/2.;
+    info.outsideRadius = std::min(info.outsideX,info.outsideY)-2;
+    info.insideX = width/2.;
+    info.insideY = height/2.;
+    info.insideRadius = 0;
+
+    // trailing records
+    while (p < end){
+        const char *eol = (const char *)memchr(p, '\n', end - p);
+        if (!eol)
+            eol = end;
+        QByteArray line(p, eol - p);
+        p = (eol < end) ? eol + 1 : end;
+        if (line.isEmpty())
+            continue;
+        QList<QByteArray> tokens = line.simplified().split(' ');
+        if (line.startsWith("outside")){
+            info.outsideX = tokenValue(tokens, 2);
+            info.outsideY = tokenValue(tokens, 3);
+            info.outsideRadius = tokenValue(tokens, 4);
+        }
+        else if (line.startsWith("DIAM")){
+            info.diameter = tokenValue(tokens, 1);
+        }
+        else if (line.startsWith("ROC")){
+            info.roc = tokenValue(tokens, 1);
+        }
+        else if (line.startsWith("Lambda")){
+            info.lambda = tokenValue(tokens, 1);
+        }
+        else if (line.startsWith("obstruction")){
+            info.insideX = tokenValue(tokens, 2);
+            info.insideY = tokenValue(tokens, 3);
+            info.insideRadius = tokenValue(tokens, 4);
+        }
+        else if (line.startsWith("ellipse_vertical_axis")){
+            info.isEllipse = true;
+            info.ellipseVerticalAxis = tokenValue(tokens, 1);
+        }
+        else if (line.startsWith("nulled")){
+            info.nulled = true;
+        }
+    }
+    return true;
+}
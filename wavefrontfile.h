@@ -0,0 +1,101 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#ifndef WAVEFRONTFILE_H
+#define WAVEFRONTFILE_H
+#include <opencv2/opencv.hpp>
+#include <QString>
+#include <QtGlobal>
+
+// Binary wave front file (.wftb).
+// A fixed 256 byte header followed by the raw pixel block.  The pixels are stored
+// as native doubles in the same row order as wavefront::data so the block can be
+// read straight into a cv::Mat_<double>.  The legacy ascii .wft files
+// store the rows bottom up instead.
+
+#define WFTB_MAGIC "DFTWFTB"
+#define WFTB_VERSION 1
+#define WFTB_BYTE_ORDER_MARK 0x01020304
+#define WFTB_DATA_ALIGNMENT 64
+
+// header flags
+#define WFTB_NULLED         0x1
+#define WFTB_ELLIPSE        0x2
+#define WFTB_OBSTRUCTION    0x4
+
+struct wftbHeader {
+    char magic[8];
+    quint32 version;
+    quint32 headerSize;         // byte offset of the pixel block from start of file
+    quint32 byteOrderMark;
+    qint32 cols;
+    qint32 rows;
+    quint32 flags;
+    double outsideX;
+    double outsideY;
+    double outsideRadius;
+    double insideX;
+    double insideY;
+    double insideRadius;
+    double diameter;
+    double roc;
+    double lambda;
+    double ellipseVerticalAxis;
+    quint64 dataBytes;
+    char reserved[136];
+};
+
+// Values found in the header or trailing records of a wave front file.
+struct wavefrontFileInfo {
+    int width;
+    int height;
+    double outsideX;
+    double outsideY;
+    double outsideRadius;
+    double insideX;
+    double insideY;
+    double insideRadius;    // 0 when there is no obstruction
+    double diameter;
+    double roc;
+    double lambda;
+    bool isEllipse;
+    double ellipseVerticalAxis;
+    bool nulled;
+    wavefrontFileInfo();
+};
+
+bool isBinaryWavefrontFile(const QString &fileName);
+bool readBinaryWavefrontHeader(const QString &fileName, wavefrontFileInfo &info);
+bool readBinaryWavefront(const QString &fileName, cv::Mat_<double> &data, wavefrontFileInfo &info);
+bool writeBinaryWavefront(const QString &fileName, const cv::Mat_<double> &data, const wavefrontFileInfo &info);
+
+// Everything needed to write a wave front file.  Made on the gui thread so the file can be written on a worker.
+struct wavefrontSaveJob {
+    QString fileName;
+    cv::Mat_<double> data;      // a copy of the data or work data
+    wavefrontFileInfo info;     // outside and inside radius include the edge offsets when they are applied
+    double outsideRadius;       // without the edge offsets
+    double insideRadius;
+};
+// Writes .wftb when the file name ends with .wftb otherwise ascii .wft
+bool writeWavefrontFile(const wavefrontSaveJob &job);
+
+// Legacy ascii .wft file.  The whole file is parsed in one pass including the trailing records.
+// info must hold the default diameter, roc and lambda to use when the file does not have them.
+bool readAsciiWavefront(const QString &fileName, cv::Mat_<double> &data, wavefrontFileInfo &info);
+
+#endif // WAVEFRONTFILE_H
@@ -17,6 +17,11 @@
 ****************************************************************************/
 #include "wavefrontloader.h"
 #include "utils.h"
+#include "zernikeprocess.h"
+#include "mirrordlg.h"
+#include "settings2.h"
+#include <QtConcurrent>
+
 waveFrontLoader::waveFrontLoader(QObject *parent) :
     QObject(parent),  done(true),shouldCancel(false)
 {
@@ -27,6 +32,10 @@ waveFrontLoader::waveFrontLoader(QObject *parent) :
     connect(this, SIGNAL(currentWavefront(QString)), pd, SLOT(setLabelText(QString)));
 }
 
+waveFrontLoader::~waveFrontLoader(){
+    delete pd;
+}
+
 void waveFrontLoader::addWavefront(QString filename){
     mutex.lock();
     m_list << filename;
@@ -43,64 +52,220 @@ void waveFrontLoader::loadx(QStringList list, SurfaceManager *sm){
     loadx(sm);
 }
 
+// Run work on every item using the thread pool while keeping the progress dialog alive.
+// Cancel stops any items not yet started.  Returns false if canceled.
+bool waveFrontLoader::runParallel(QVector<loadItem> &items, std::function<void(loadItem &)> work,
+                                  const QString &label){
+    emit currentWavefront(label);
+    emit progressRange(0, items.size());
+    emit status(0);
+
+    QFutureWatcher<void> watcher;
+    QEventLoop loop;
+    connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+    connect(&watcher, SIGNAL(progressValueChanged(int)), this, SIGNAL(status(int)));
+    connect(pd, SIGNAL(canceled()), &watcher, SLOT(cancel()));
+    watcher.setFuture(QtConcurrent::map(items, work));
+    if (!watcher.isFinished())
+        loop.exec();
+    watcher.waitForFinished();
+    return !shouldCancel;
+}
+
+// Ask once about all the files whose lambda, diameter or roc do not match the mirror config
+// instead of once for each file.
+void waveFrontLoader::askAboutMismatches(const QVector<loadItem> &items, SurfaceManager *sm){
+    mirrorDlg *md = mirrorDlg::get_Instance();
+    bool lambdaDiffers = false;
+    bool diamDiffers = false;
+    bool rocDiffers = false;
+    QStringList lines;
+    foreach(const loadItem &item, items){
+        if (!item.wf)
+            continue;
+        QStringList diffs;
+        if (sm->lambdResp == ASK && item.info.lambda != md->lambda){
+            lambdaDiffers = true;
+            diffs << QString("Lambda %1").arg(item.info.lambda, 6, 'f', 3);
+        }
+        if (sm->diamResp == ASK && roundl(item.info.diameter * 10) != roundl(md->diameter * 10)){
+            diamDiffers = true;
+            diffs << QString("Diameter %1").arg(item.info.diameter, 6, 'f', 3);
+        }
+        if (sm->rocResp == ASK && roundl(item.info.roc * 10.) != roundl(md->roc * 10.)){
+            rocDiffers = true;
+            diffs << QString("ROC %1").arg(item.info.roc, 6, 'f', 3);
+        }
+        if (diffs.size() > 0)
+            lines << QFileInfo(item.fileName).fileName() + ": " + diffs.join(", ");
+    }
+    if (lines.size() == 0)
+        return;
+
+    if (lines.size() > 10){
+        int more = lines.size() - 10;
+        lines = lines.mid(0, 10);
+        lines << QString("and %1 more.").arg(more);
+    }
+    QString message = QString("These wavefronts do not match the config values of\n"
+                              "Lambda %1  Diameter %2  ROC %3\n\n")
+            .arg(md->lambda, 6, 'f', 3).arg(md->diameter, 6, 'f', 3).arg(md->roc, 6, 'f', 3) +
+            lines.join("\n") + "\n\nDo you want to make the config match?";
+    pd->hide();
+    int resp = QMessageBox(QMessageBox::Information, "config", message,
+                           QMessageBox::Yes | QMessageBox::No).exec();
+    pd->show();
+    configRESPONSE r = (resp == QMessageBox::Yes) ? YES : NO;
+    if (lambdaDiffers)
+        sm->lambdResp = r;
+    if (diamDiffers)
+        sm->diamResp = r;
+    if (rocDiffers)
+        sm->rocResp = r;
+}
+
+// Read the files, make the masks and fit the zernikes on the thread pool then add the
+// results to the surface manager in the original file order.
 void waveFrontLoader::loadx( SurfaceManager *sm){
 
     shouldCancel = false;
-    int prog = 0;
-    int size = m_list.size();
-
-    emit status(0);
-    bool mirrorConfigChanged = false;
     done = false;
 
-    emit progressRange(0, size);
-    sm->okToUpdateSurfacesOnGenerateComplete = false;
-    try {
-        while (m_list.size() > 0){
-            int left = showmem();
-            qDebug() << left;
-            if (left < 300){
-                qDebug() << "low memory";
-                sm->okToContinue = -1;
-                emit memoryLow();
-                while(sm->okToContinue == -1){}
-                qDebug() << "continue code" << sm->okToContinue;
-                if (sm->okToContinue == QMessageBox::No)
-                {
-                    qDebug() << "Abort load";
-                    break;
-                }
-                qDebug() << "Continue load";
+    mutex.lock();
+    QVector<loadItem> items(m_list.size());
+    wavefrontFileInfo defaults = SurfaceManager::defaultFileInfo();
+    for (int i = 0; i < m_list.size(); ++i){
+        items[i].fileName = m_list[i];
+        items[i].info = defaults;
+    }
+    m_list.clear();
+    mutex.unlock();
 
-            }
-            mutex.lock();
-            QString file = m_list.front();
-            m_list.removeAt(0);
-            mutex.unlock();
+    pd->reset();
+    pd->show();
+    sm->okToUpdateSurfacesOnGenerateComplete = false;
 
-            if (pd->wasCanceled())
-                break;
+    // read the files
+    runParallel(items, [](loadItem &item){
+        try {
+            item.wf = SurfaceManager::readWaveFrontFile(item.fileName, item.info, item.error);
+        }
+        catch (const std::bad_alloc &){
+            item.error = "Out of memory reading " + item.fileName;
+        }
+    }, "Reading wavefronts");
 
-            emit currentWavefront(file);
+    // apply the headers in order on the gui thread.  They can change the mirror config.
+    if (!shouldCancel)
+        askAboutMismatches(items, sm);
+    QStringList failed;
+    for (int i = 0; i < items.size(); ++i){
+        loadItem &item = items[i];
+        if (!item.error.isEmpty())
+            failed << item.error;
+        if (!item.wf)
+            continue;
+        if (shouldCancel){
+            delete item.wf;
+            item.wf = 0;
+            continue;
+        }
+        sm->applyWaveFrontFileInfo(item.wf, item.info);
+    }
 
-            emit status(++prog);
-            mirrorConfigChanged |= sm->loadWavefront(file);
+    // masks and zernike fit.  Annular zernikes and ellipses are left for generateSurfacefromWavefront
+    // because they use state in zernikeProcess.
+    bool downSize = Settings2::getInstance()->m_general->shouldDownsize();
+    bool fitZerns = !mirrorDlg::get_Instance()->m_useAnnular && !mirrorDlg::get_Instance()->isEllipse();
+    zernikeProcess *zp = zernikeProcess::get_Instance();
+    if (!shouldCancel){
+        runParallel(items, [sm, zp, downSize, fitZerns](loadItem &item){
+            if (!item.wf)
+                return;
+            try {
+                if (downSize)
+                    sm->downSizeWf(item.wf);
+                sm->buildMask(item.wf);
+                if (fitZerns){
+                    if (!zp->unwrap_to_zernikes(*item.wf)){
+                        item.error = "Zernike fit failed for " + item.fileName;
+                        return;
+                    }
+                    item.wf->zernsPrefit = true;
+                }
+                item.prepared = true;
+            }
+            catch (const std::bad_alloc &){
+                item.error = "Out of memory preparing " + item.fileName;
+            }
+        }, "Computing masks and Zernikes");
+        for (int i = 0; i < items.size(); ++i){
+            if (items[i].wf && !items[i].prepared && !items[i].error.isEmpty())
+                failed << items[i].error;
         }
     }
-    catch (const std::bad_alloc &ex)
-    {
-        // clean up here, e.g. save the session
-        // and close all config files.
 
-        return;
+    // add them in order
+    // with a memory budget the residency manager spills older wave fronts to disk instead.
+    bool checkMemory = Settings2::getInstance()->m_general->memoryBudgetMB() == 0;
+    QSettings settings;
+    int memThreshold = settings.value("lowMemoryThreshold", 300).toInt();
+    emit progressRange(0, items.size());
+    int prog = 0;
+    bool stop = false;
+    for (int i = 0; i < items.size(); ++i){
+        loadItem &item = items[i];
+        if (!item.wf)
+            continue;
+        if (!stop){
+            QApplication::processEvents();
+            if (pd->wasCanceled())
+                stop = true;
+        }
+        if (!stop && checkMemory && showmem() < memThreshold){
+            qDebug() << "low memory";
+            int resp = QMessageBox::warning(0,"low on memory", "Do you want to continue?",
+                                            QMessageBox::Yes|QMessageBox::No);
+            if (resp == QMessageBox::No){
+                qDebug() << "Abort load";
+                stop = true;
+            }
+        }
+        if (stop || !item.prepared){
+            delete item.wf;
+            item.wf = 0;
+            continue;
+        }
+        emit currentWavefront(item.fileName);
+        emit status(++prog);
+        wavefront *wf = item.wf;
+        item.wf = 0;
+        try {
+            sm->addLoadedWavefront(wf, item.fileName);
+        }
+        catch (int){
+            stop = true;
+        }
     }
 
-    emit loadComplete();
     sm->okToUpdateSurfacesOnGenerateComplete = true;
+    sm->loadComplete();
+    emit loadComplete();
     done = true;
     emit progressRange(0, 1);
     emit status(0);
     emit status(1);
+    pd->hide();
 
+    // one message for all the files that could not be read
+    if (failed.size() > 0){
+        int count = failed.size();
+        if (count > 20){
+            failed = failed.mid(0, 20);
+            failed << "...";
+        }
+        QMessageBox::warning(0, tr("Read Wavefront File"),
+                             tr("%1 of %2 wave fronts could not be read:\n").arg(count).arg(items.size()) +
+                             failed.join("\n"));
+    }
 }
-
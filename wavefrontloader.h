@@ -22,13 +22,16 @@
 #include <QtWidgets>
 #include <QtCore>
 #include "surfacemanager.h"
+#include "wavefrontfile.h"
 #include <QMutex>
+#include <functional>
 
 class waveFrontLoader : public QObject
 {
     Q_OBJECT
 public:
     explicit waveFrontLoader(QObject *parent = 0);
+    ~waveFrontLoader();
     void addWavefront(QString filename);
     bool done;
 signals:
@@ -48,6 +51,18 @@ public slots:
 
 
 private:
+    // one per file.  Kept in the order the files were given so the results can be
+    // added to the surface manager in that order.
+    struct loadItem {
+        QString fileName;
+        wavefront *wf;
+        wavefrontFileInfo info;
+        QString error;
+        bool prepared;
+        loadItem():wf(0), prepared(false){}
+    };
+    bool runParallel(QVector<loadItem> &items, std::function<void(loadItem &)> work, const QString &label);
+    void askAboutMismatches(const QVector<loadItem> &items, SurfaceManager *sm);
     QProgressDialog *pd;
     bool shouldCancel;
     QMutex sync;
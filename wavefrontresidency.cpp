@@ -0,0 +1,195 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#include "wavefrontresidency.h"
+#include "wavefront.h"
+#include "settings2.h"
+#include <QTemporaryDir>
+#include <QFile>
+#include <QDebug>
+#include <QMutexLocker>
+
+wavefrontResidency *wavefrontResidency::get_Instance(){
+    static wavefrontResidency *instance = new wavefrontResidency();
+    return instance;
+}
+
+wavefrontResidency::wavefrontResidency(): m_displayed(0), m_spillDir(0), m_spillCount(0)
+{
+}
+
+qint64 wavefrontResidency::bytesOf(wavefront *wf){
+    return wf->data.total() * wf->data.elemSize() +
+            wf->nulledData.total() * wf->nulledData.elemSize() +
+            wf->mask.total() * wf->mask.elemSize() +
+            wf->workData.total() * wf->workData.elemSize() +
+            wf->workMask.total() * wf->workMask.elemSize();
+}
+
+// Releasing a buffer someone else also holds would not free anything and the
+// other holder's changes would be lost when it is read back.
+static bool sharedMat(const cv::Mat &m){
+    return m.u && m.u->refcount > 1;
+}
+
+bool wavefrontResidency::isShared(wavefront *wf){
+    return sharedMat(wf->data) || sharedMat(wf->nulledData) || sharedMat(wf->mask) ||
+            sharedMat(wf->workData) || sharedMat(wf->workMask);
+}
+
+qint64 wavefrontResidency::residentBytes(){
+    QMutexLocker lock(&m_mutex);
+    qint64 total = 0;
+    foreach(wavefront *wf, m_lru){
+        if (!m_spilled.contains(wf))
+            total += bytesOf(wf);
+    }
+    return total;
+}
+
+bool wavefrontResidency::isSpilled(wavefront *wf){
+    QMutexLocker lock(&m_mutex);
+    return m_spilled.contains(wf);
+}
+
+// Make wf resident and the most recently used then spill others if over budget.
+void wavefrontResidency::touch(wavefront *wf){
+    if (!wf)
+        return;
+    QMutexLocker lock(&m_mutex);
+    if (m_spilled.contains(wf))
+        reload(wf);
+    m_lru.removeOne(wf);
+    m_lru.append(wf);
+    enforceBudget(wf);
+}
+
+void wavefrontResidency::setDisplayed(wavefront *wf){
+    QMutexLocker lock(&m_mutex);
+    m_displayed = wf;
+    if (!wf)
+        return;
+    if (m_spilled.contains(wf))
+        reload(wf);
+    m_lru.removeOne(wf);
+    m_lru.append(wf);
+    enforceBudget(wf);
+}
+
+// Called when a wave front is deleted.
+void wavefrontResidency::forget(wavefront *wf){
+    QMutexLocker lock(&m_mutex);
+    if (m_displayed == wf)
+        m_displayed = 0;
+    m_lru.removeOne(wf);
+    if (m_spilled.contains(wf)){
+        QFile::remove(m_spilled[wf]);
+        m_spilled.remove(wf);
+    }
+}
+
+void wavefrontResidency::enforceBudget(wavefront *keep){
+    qint64 budget = (qint64)Settings2::getInstance()->m_general->memoryBudgetMB() * 1024 * 1024;
+    if (budget <= 0)
+        return;
+    qint64 total = 0;
+    foreach(wavefront *wf, m_lru){
+        if (!m_spilled.contains(wf))
+            total += bytesOf(wf);
+    }
+    for (int i = 0; i < m_lru.size() && total > budget; ++i){
+        wavefront *wf = m_lru[i];
+        if (wf == keep || wf == m_displayed || m_spilled.contains(wf) || isShared(wf))
+            continue;
+        qint64 bytes = bytesOf(wf);
+        if (spill(wf))
+            total -= bytes;
+    }
+}
+
+static bool writeMat(QFile &file, const cv::Mat &m){
+    qint32 dims[3] = {m.rows, m.cols, m.type()};
+    if (file.write((const char *)dims, sizeof(dims)) != (qint64)sizeof(dims))
+        return false;
+    const qint64 rowBytes = m.cols * m.elemSize();
+    for (int row = 0; row < m.rows; ++row){
+        if (file.write((const char *)m.ptr(row), rowBytes) != rowBytes)
+            return false;
+    }
+    return true;
+}
+
+static bool readMat(QFile &file, cv::Mat &m){
+    qint32 dims[3];
+    if (file.read((char *)dims, sizeof(dims)) != (qint64)sizeof(dims))
+        return false;
+    if (dims[0] == 0 || dims[1] == 0){
+        m.release();
+        return true;
+    }
+    m.create(dims[0], dims[1], dims[2]);
+    qint64 bytes = m.total() * m.elemSize();
+    return file.read((char *)m.data, bytes) == bytes;
+}
+
+bool wavefrontResidency::spill(wavefront *wf){
+    if (!m_spillDir){
+        m_spillDir = new QTemporaryDir();
+        if (!m_spillDir->isValid()){
+            qDebug() << "can not create wavefront spill directory";
+            return false;
+        }
+    }
+    QString fileName = m_spillDir->filePath(QString("wf%1.spill").arg(m_spillCount++));
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) ||
+            !writeMat(file, wf->data) || !writeMat(file, wf->nulledData) || !writeMat(file, wf->mask) ||
+            !writeMat(file, wf->workData) || !writeMat(file, wf->workMask)){
+        qDebug() << "wavefront spill failed" << wf->name;
+        file.close();
+        QFile::remove(fileName);
+        return false;
+    }
+    wf->data.release();
+    wf->nulledData.release();
+    wf->mask.release();
+    wf->workData.release();
+    wf->workMask.release();
+    m_spilled[wf] = fileName;
+    return true;
+}
+
+bool wavefrontResidency::reload(wavefront *wf){
+    QString fileName = m_spilled.take(wf);
+    QFile file(fileName);
+    cv::Mat data, nulledData, mask, workData, workMask;
+    bool ok = file.open(QIODevice::ReadOnly) &&
+            readMat(file, data) && readMat(file, nulledData) && readMat(file, mask) &&
+            readMat(file, workData) && readMat(file, workMask);
+    file.close();
+    QFile::remove(fileName);
+    if (!ok){
+        qDebug() << "wavefront reload failed" << wf->name;
+        return false;
+    }
+    wf->data = data;
+    wf->nulledData = nulledData;
+    wf->mask = mask;
+    wf->workData = workData;
+    wf->workMask = workMask;
+    return true;
+}
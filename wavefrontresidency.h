@@ -0,0 +1,58 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#ifndef WAVEFRONTRESIDENCY_H
+#define WAVEFRONTRESIDENCY_H
+#include <QList>
+#include <QHash>
+#include <QString>
+#include <QMutex>
+
+class wavefront;
+class QTemporaryDir;
+
+// Keeps the pixel buffers of the loaded wave fronts within the memory budget set in the general settings.
+// When over budget the least recently used wave fronts have their data, masks and work data written to a
+// spill file in a temporary directory and released.  touch() reads them back, so call it before using the
+// pixels of any wave front that may not be the current one.  The wave front the views show is never spilled.
+class wavefrontResidency
+{
+public:
+    static wavefrontResidency *get_Instance();
+    void touch(wavefront *wf);
+    // touch and keep wf resident while the surface views hold it
+    void setDisplayed(wavefront *wf);
+    void forget(wavefront *wf);
+    bool isSpilled(wavefront *wf);
+    qint64 residentBytes();
+private:
+    wavefrontResidency();
+    void enforceBudget(wavefront *keep);
+    bool spill(wavefront *wf);
+    bool reload(wavefront *wf);
+    static qint64 bytesOf(wavefront *wf);
+    static bool isShared(wavefront *wf);
+
+    QList<wavefront *> m_lru;               // least recently used first
+    QHash<wavefront *, QString> m_spilled;  // spill file of each spilled wave front
+    wavefront *m_displayed;
+    QTemporaryDir *m_spillDir;
+    int m_spillCount;
+    QMutex m_mutex;
+};
+
+#endif // WAVEFRONTRESIDENCY_H
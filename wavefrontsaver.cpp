@@ -0,0 +1,107 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#include "wavefrontsaver.h"
+#include "surfacemanager.h"
+#include "wavefrontfile.h"
+#include <QtConcurrent>
+#include <QMessageBox>
+#include <QThread>
+
+waveFrontSaver::waveFrontSaver(SurfaceManager *sm, QList<wavefront *> wavefronts, QStringList fileNames,
+                               bool saveNulled) :
+    QObject(sm), m_sm(sm), m_wavefronts(wavefronts), m_fileNames(fileNames), m_saveNulled(saveNulled),
+    m_next(0), m_inFlight(0), m_done(0), m_canceled(false)
+{
+    m_maxInFlight = qMax(2, QThread::idealThreadCount());
+    m_pd = new QProgressDialog("Saving wavefront files", "Cancel", 0, m_wavefronts.size());
+    m_pd->setMinimumDuration(0);
+    connect(m_pd, SIGNAL(canceled()), this, SLOT(cancel()));
+    connect(m_sm, SIGNAL(deleteWavefront(int)), this, SLOT(wavefrontDeleted(int)));
+}
+
+void waveFrontSaver::start(){
+    m_pd->setValue(0);
+    startJobs();
+    if (m_inFlight == 0)
+        jobDone();
+}
+
+void waveFrontSaver::cancel(){
+    m_canceled = true;
+}
+
+// Called just before the surface manager deletes the wave front so its address can not be mistaken
+// for a new wave front allocated later at the same place.
+void waveFrontSaver::wavefrontDeleted(int ndx){
+    wavefront *wf = m_sm->m_wavefronts[ndx];
+    for (int i = m_next; i < m_wavefronts.size(); ++i){
+        if (m_wavefronts[i] == wf)
+            m_wavefronts[i] = 0;
+    }
+}
+
+void waveFrontSaver::startJobs(){
+    while (!m_canceled && m_inFlight < m_maxInFlight && m_next < m_wavefronts.size()){
+        wavefront *wf = m_wavefronts[m_next];
+        QString fileName = m_fileNames[m_next];
+        ++m_next;
+        // it may have been deleted since the save started.
+        if (!wf){
+            m_failed << fileName + " (wave front was deleted)";
+            ++m_done;
+            continue;
+        }
+        wavefrontSaveJob job = m_sm->makeSaveJob(fileName, wf, m_saveNulled);
+        QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+        watcher->setProperty("fileName", fileName);
+        connect(watcher, SIGNAL(finished()), this, SLOT(jobDone()));
+        watcher->setFuture(QtConcurrent::run(writeWavefrontFile, job));
+        ++m_inFlight;
+    }
+}
+
+void waveFrontSaver::jobDone(){
+    QFutureWatcher<bool> *watcher = qobject_cast<QFutureWatcher<bool> *>(sender());
+    if (watcher){
+        --m_inFlight;
+        ++m_done;
+        if (!watcher->result())
+            m_failed << watcher->property("fileName").toString();
+        watcher->deleteLater();
+    }
+    if (!m_canceled)
+        m_pd->setValue(m_done);
+    startJobs();
+    if (m_inFlight > 0 || (!m_canceled && m_next < m_wavefronts.size()))
+        return;
+
+    m_pd->hide();
+    m_pd->deleteLater();
+    if (m_failed.size() > 0){
+        int count = m_failed.size();
+        if (count > 20){
+            m_failed = m_failed.mid(0, 20);
+            m_failed << "...";
+        }
+        QMessageBox::warning(0, tr("Write wave front"),
+                             tr("%1 of %2 wave fronts could not be written:\n").arg(count).arg(m_wavefronts.size()) +
+                             m_failed.join("\n"));
+    }
+    emit finished();
+    deleteLater();
+}
@@ -0,0 +1,61 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+#ifndef WAVEFRONTSAVER_H
+#define WAVEFRONTSAVER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QList>
+#include <QFutureWatcher>
+#include <QProgressDialog>
+
+class SurfaceManager;
+class wavefront;
+
+// Writes a batch of wave fronts in the background.  Each wave front is copied on the gui thread just
+// before its file is written on the thread pool and only a few copies are alive at once so memory stays
+// bounded.  Wave fronts deleted from the surface manager before their turn are dropped from the batch.
+// Failures are reported in one message when the batch is done.  Deletes itself when finished.
+class waveFrontSaver : public QObject
+{
+    Q_OBJECT
+public:
+    waveFrontSaver(SurfaceManager *sm, QList<wavefront *> wavefronts, QStringList fileNames, bool saveNulled);
+    void start();
+signals:
+    void finished();
+private slots:
+    void jobDone();
+    void cancel();
+    void wavefrontDeleted(int ndx);
+private:
+    void startJobs();
+    SurfaceManager *m_sm;
+    QList<wavefront *> m_wavefronts;
+    QStringList m_fileNames;
+    bool m_saveNulled;
+    int m_next;
+    int m_inFlight;
+    int m_maxInFlight;
+    int m_done;
+    bool m_canceled;
+    QStringList m_failed;
+    QProgressDialog *m_pd;
+};
+
+#endif // WAVEFRONTSAVER_H
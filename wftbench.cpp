@@ -0,0 +1,110 @@
+/******************************************************************************
+**
+**  Copyright 2016 Dale Eason
+**  This file is part of DFTFringe
+**  is free software: you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation version 3 of the License
+
+** DFTFringe is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with DFTFringe.  If not, see <http://www.gnu.org/licenses/>.
+
+****************************************************************************/
+// wftbench: times the ascii .wft reader against the stream based reader it replaced.
+//
+//   wftbench
+//
+// Writes 512, 1024 and 2048 pixel wave fronts to the temp directory, reads each with both readers and
+// prints the times, the speedup and the largest difference of the data.
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <fstream>
+#include "wavefrontfile.h"
+
+// The stream based reader readAsciiWavefront replaced.
+static bool readAsciiWavefrontStream(const QString &fileName, cv::Mat_<double> &data){
+    std::ifstream file(fileName.toStdString().c_str());
+    if (!file)
+        return false;
+    double width;
+    double height;
+    file >> width;
+    file >> height;
+    data = cv::Mat_<double>(height, width, 0.);
+    for( size_t y = 0; y < height; y++ ) {
+        for( size_t x = 0; x < width; x++ ) {
+            file >> data.at<double>(height - y-1,x);
+        }
+    }
+    std::string line;
+    while (getline(file, line)) {
+    }
+    return true;
+}
+
+// readAsciiWavefront against the stream reader on generated 512, 1024 and 2048 files.
+static QString benchmarkAsciiWavefrontReaders(){
+    QString report("size      stream ms   new ms   speedup   max diff\n");
+    const int sizes[] = {512, 1024, 2048};
+    for (int size : sizes){
+        // a smooth surface inside a circle written the same way SurfaceManager::writeWavefront does.
+        cv::Mat_<double> surface = cv::Mat_<double>::zeros(size, size);
+        double c = (size - 1)/2.;
+        double r = c - 2;
+        for (int y = 0; y < size; ++y){
+            for (int x = 0; x < size; ++x){
+                double dx = (x - c)/r;
+                double dy = (y - c)/r;
+                double rho2 = dx * dx + dy * dy;
+                if (rho2 <= 1.)
+                    surface(y,x) = .3 * (6 * rho2 * rho2 - 6 * rho2 + 1) + .05 * dx * dy + 1e-5 * (x % 7);
+            }
+        }
+        QString fileName = QDir::temp().filePath(QString("dftfringe_bench_%1.wft").arg(size));
+        {
+            std::ofstream file(fileName.toStdString().c_str());
+            file << size << std::endl << size << std::endl;
+            for (int row = size - 1; row >= 0; --row)
+                for (int col = 0; col < size; ++col)
+                    file << surface(row,col) << '\n';
+            file << "outside ellipse " << c << " " << c << " " << r << " " << r << std::endl;
+            file << "DIAM " << 200. << std::endl << "ROC " << 2000. << std::endl << "Lambda " << 632.8 << std::endl;
+        }
+
+        QElapsedTimer timer;
+        cv::Mat_<double> streamData;
+        timer.start();
+        readAsciiWavefrontStream(fileName, streamData);
+        double streamTime = timer.nsecsElapsed() * 1e-6;
+
+        cv::Mat_<double> newData;
+        wavefrontFileInfo info;
+        timer.restart();
+        bool ok = readAsciiWavefront(fileName, newData, info);
+        double newTime = timer.nsecsElapsed() * 1e-6;
+
+        double maxDiff = -1;
+        if (ok && newData.size() == streamData.size())
+            maxDiff = cv::norm(newData, streamData, cv::NORM_INF);
+        report += QString("%1 %2 %3 %4 %5\n").arg(size, -6)
+                .arg(streamTime, 12, 'f', 1).arg(newTime, 8, 'f', 1)
+                .arg(streamTime / newTime, 9, 'f', 1).arg(maxDiff, 10, 'g', 3);
+        QFile::remove(fileName);
+    }
+    return report;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    fputs(qPrintable(benchmarkAsciiWavefrontReaders()), stdout);
+    return 0;
+}
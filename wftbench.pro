@@ -0,0 +1,20 @@
+# wftbench: times the ascii .wft reader against the stream based reader it replaced.
+# Builds the same sources as DFTFringe with its own main.  Build it in its own build directory, for example
+#   mkdir build-wftbench && cd build-wftbench && qmake ../wftbench.pro && make
+
+include(DFTFringe.pro)
+
+TARGET = wftbench
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES -= main.cpp
+SOURCES += wftbench.cpp
+
+macx {
+    # keep the objects apart from the gui build which uses the same DESTDIR
+    MOC_DIR = $$DESTDIR/.moc-wftbench
+    OBJECTS_DIR = $$DESTDIR/.obj-wftbench
+    RCC_DIR = $$DESTDIR/.qrc-wftbench
+    UI_DIR = $$DESTDIR/.ui-wftbench
+}
@@ -18,6 +18,7 @@
 #include "wftstats.h"
 #include <qwt_scale_draw.h>
 #include "wavefront.h"
+#include "wavefrontresidency.h"
 #include "zernikedlg.h"
 #include <qwt_plot_histogram.h>
 #include <QTextStream>
@@ -260,6 +261,7 @@ void wftStats::computeWftRunningAvg( QVector<wavefront*> wavefronts, int ndx){
     int last = wavefronts.length();
     QHash<QString,int> sizes;
     for (int i = 0; i < last; ++i){
+        wavefrontResidency::get_Instance()->touch(wavefronts[i]);
         QString size = QString("%1 %2").arg(wavefronts[i]->workData.rows).arg(wavefronts[i]->workData.cols);
         if (*sizes.find(size))
         {
@@ -282,10 +284,11 @@ void wftStats::computeWftRunningAvg( QVector<wavefront*> wavefronts, int ndx){
     QTextStream s(&maxkey);
 
     s >> rrows >> rcols;
+    wavefrontResidency::get_Instance()->touch(wavefronts[0]);
     cv::Mat mask = wavefronts[0]->workMask.clone();
     cv::resize(mask,mask,cv::Size(rcols,rrows));
     QVector<wavefront*> twaves = wavefronts;
-    cv::Mat sum = cv::Mat::zeros(rrows,rcols, wavefronts[ndx]->workData.type());
+    cv::Mat sum = cv::Mat::zeros(rrows,rcols, CV_64F);
 
     avgPoints.clear();
     wftPoints.clear();
@@ -294,6 +297,7 @@ void wftStats::computeWftRunningAvg( QVector<wavefront*> wavefronts, int ndx){
     for (int j = 0; j < last; ++j){
         int i = (ndx + j) % wavefronts.size();
         //i = samndx[j];
+        wavefrontResidency::get_Instance()->touch(twaves[i]);
         cv::Mat resized = twaves[i]->workData.clone();
         if (twaves[i]->workData.rows != rrows || twaves[i]->workData.cols != rcols){
             cv::resize(twaves[i]->workData,resized, cv::Size(rcols, rrows));
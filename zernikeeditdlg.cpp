@@ -5,6 +5,7 @@
 #include "zernikeprocess.h"
 #include "mirrordlg.h"
 #include "myutils.h"
+#include "wavefrontresidency.h"
 zernikeEditDlg::zernikeEditDlg(SurfaceManager * sfm, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::zernikeEditDlg), m_sm(sfm), shouldEnableAll(false)
@@ -152,6 +153,7 @@ void zernikeEditDlg::on_useCurrent_clicked()
     m_zernEnables = zernEnables;
     tableModel->blockSignals(true);
 
+    wavefrontResidency::get_Instance()->touch(m_sm->m_wavefronts[m_sm->m_currentNdx]);
     tableModel->setValues(m_sm->m_wavefronts[m_sm->m_currentNdx]->InputZerns,m_sm->m_wavefronts[m_sm->m_currentNdx]->useSANull );
     ui->sizeSb->setValue(m_sm->m_wavefronts[m_sm->m_currentNdx]->data.cols);
     tableModel->blockSignals(false);
@@ -20,6 +20,7 @@
 #include <cmath>
 #include "mainwindow.h"
 #include <QDebug>
+#include <QThread>
 #include "surfaceanalysistools.h"
 #include "simigramdlg.h"
 #include "settings2.h"
@@ -608,7 +609,7 @@ zernikeProcess::zernikeProcess(QObject *parent) :
 
 // compute zernikes from unwrapped surface
 #define SAMPLE_WIDTH 1
-void zernikeProcess::unwrap_to_zernikes(wavefront &wf, int zterms){
+bool zernikeProcess::unwrap_to_zernikes(wavefront &wf, int zterms){
 
     int nx = wf.data.cols;
     int ny = wf.data.rows;
@@ -624,7 +625,7 @@ void zernikeProcess::unwrap_to_zernikes(wavefront &wf, int zterms){
         initGrid(wf, 12);
         ZernFitWavefront(wf);
 
-        return;
+        return true;
     }
     /*
     'calculate LSF matrix elements
@@ -661,7 +662,7 @@ void zernikeProcess::unwrap_to_zernikes(wavefront &wf, int zterms){
     }
 
     double delta = 1./(wf.m_outside.m_radius);
-    zernikePolar &zpolar = *zernikePolar::get_Instance();
+    zernikePolar zpolar;    // local so the fit can run on the wave front loader threads
     int sampleCnt = 0;
     for(int y = 0; y < ny; y += step) //for each point on the surface
     {
@@ -673,6 +674,14 @@ void zernikeProcess::unwrap_to_zernikes(wavefront &wf, int zterms){
             double rho = sqrt(ux * ux + uy * uy);
 
             if ( rho <= 1. && (wf.mask.at<uchar>(y,x) != 0) && wf.data.at<double>(y,x) != 0.0){
+                if (useSvd && sampleCnt >= count){
+                    QString msg = QString("Zernike computation sampleCnt > count %1 %2").arg(sampleCnt + 1).arg(count);
+                    if (QThread::currentThread() == qApp->thread())
+                        QMessageBox::warning(0,"Critical Error", msg);
+                    else
+                        qDebug() << wf.name << msg;
+                    return false;
+                }
                 double theta = atan2(uy,ux);
                 zpolar.init(rho, theta);
                 for ( int i = 0; i < zterms; ++i)
@@ -698,10 +707,6 @@ void zernikeProcess::unwrap_to_zernikes(wavefront &wf, int zterms){
                 }
                 if (useSvd){
                     B(sampleCnt++) = surface.at<double>(y,x);
-                    if (sampleCnt > count){
-                        QMessageBox::warning(0,"Critical Error", QString("Zernike computation sampleCnt > count %1 %2").arg(sampleCnt).arg(count));
-                        return ;
-                    }
                 }
             }
         }
@@ -719,8 +724,7 @@ void zernikeProcess::unwrap_to_zernikes(wavefront &wf, int zterms){
     for (int z = 0; z < X.rows; ++z){
         wf.InputZerns[z] = X(z);
     }
-
-
+    return true;
 }
 
 cv::Mat zernikeProcess::null_unwrapped(wavefront&wf, std::vector<double> zerns, std::vector<bool> enables,
@@ -105,7 +105,8 @@ public:
     bool m_lastusedAnnulus;
     explicit zernikeProcess(QObject *parent = 0);
     static zernikeProcess *get_Instance();
-    void unwrap_to_zernikes(wavefront &wf, int zterms = Z_TERMS);
+    // false when the fit could not be done.  Only warns with a message box on the gui thread.
+    bool unwrap_to_zernikes(wavefront &wf, int zterms = Z_TERMS);
     cv::Mat null_unwrapped(wavefront&wf,  std::vector<double> zerns, std::vector<bool> enables,int start_term =0, int last_term = Z_TERMS);
     std::vector<double> ZernFitWavefront( wavefront &wf);
     void initGrid(wavefront &wf, int maxOrder);
@@ -5,6 +5,10 @@
 #include "zernikeprocess.h"
 #include "wavefront.h"
 #include "simigramdlg.h"
+
+// width x width surface of theZerns on the grid zp was last initialized with.  Zero off the grid.
+cv::Mat makeSurfaceFromZerns(int width, zernikeProcess &zp, std::vector<double> theZerns);
+
 namespace Ui {
 class ZernikeSmoothingDlg;
 }